@@ -2,25 +2,53 @@
 
 #include <asm-generic/int-ll64.h>
 #include <cstdint>
-#include <limits>
-#include <random>
 #include <sys/select.h>
-#include <unordered_set>
 #include <cassert>
+#include <math.h>
+#include <string.h>
 #include "city.h"
 #include "cuckoo_filter.h"
+#include "perf_counter.h"
+#include "workload.h"
 #include "yeah_filter.h"
 
 constexpr size_t num_fp_test = 100000;
 constexpr int randseed = 20211124;
 
+// Set by --perf: wrap the insert and query phases with hardware counters.
+static bool perf_mode = false;
+
 size_t cuckoo_cityhash(uint32_t x) 
 {
 	return CityHash64((const char*) &x, sizeof(x));
 }
 
-#define BENCHMARK_FILTER CuckooFilter
-/* #define BENCHMARK_FILTER YeahFilter */
+// The dimension of the bucket space when benchmarking YeahFilter.
+#define BENCHMARK_DIM 2
+
+// Whether the table keeps per-bucket occupancy bitmaps.
+#define BENCHMARK_OCCUPANCY false
+
+template<int bits_per_key, class Key, class Hash, int way>
+using CuckooFilterBench = CuckooFilter<bits_per_key, Key, Hash, way, BENCHMARK_OCCUPANCY>;
+
+template<int bits_per_key, class Key, class Hash, int way>
+using YeahFilterBench = YeahFilter<bits_per_key, Key, Hash, way, BENCHMARK_DIM, BENCHMARK_OCCUPANCY>;
+
+#define BENCHMARK_FILTER CuckooFilterBench
+/* #define BENCHMARK_FILTER YeahFilterBench */
+
+/**
+ * Append the counters of one phase as per-operation values. Unavailable
+ * counters are printed as nan so that the columns stay aligned.
+ */
+static void log_perf(const PerfCounters &perf, size_t num_ops)
+{
+	for (int e = 0; e < PerfCounters::kNumEvents; e++) {
+		double v = perf.available(e) ? (double) perf.value(e) / num_ops : NAN;
+		log_info(" %.3f", v);
+	}
+}
 
 /**
  * @param capacity     The number of element fingerprints.
@@ -29,71 +57,99 @@ size_t cuckoo_cityhash(uint32_t x)
  * @param num_elem     The number of elements to be inserted in to the filter.
  * We can also calcuate (1) num_buckets = capcacity / way, and (2) load factor = num_elem / capacity.
  */
-template<int capacity, int bits_per_key, int way, int num_elem>
-void run_benchmark() 
+template<int bits_per_key, int way>
+void run_benchmark(size_t capacity, size_t num_elem)
 {
-	std::mt19937 gen(randseed);
-	// closed interval
-	std::uniform_int_distribution<uint32_t> distrib(0, std::numeric_limits<uint32_t>::max());
-	auto generate_rand = [&]() {
-		return distrib(gen);
-	};
-
-	std::unordered_set<uint32_t> element_set;
-	std::vector<uint32_t> element_sequence;
-
-	for (size_t loop = 0; loop < num_elem; loop++) {
-		uint32_t x;
-		do {
-			x = generate_rand();
-		} while (element_set.count(x));
-
-		element_sequence.push_back(x);
-		element_set.insert(x);
-	}
+	// Distinct keys without a hash set: the first num_elem outputs of a
+	// bijection are inserted, and the following ones are known negatives.
+	KeyPermutation<uint32_t> perm(randseed);
+
+	std::vector<uint32_t> element_sequence(num_elem);
+	generate_keys(element_sequence.data(), 0, num_elem, perm);
+
+	std::vector<uint32_t> fp_sequence(num_fp_test);
+	generate_keys(fp_sequence.data(), num_elem, num_fp_test, perm);
 
 	BENCHMARK_FILTER<bits_per_key, uint32_t, decltype(&cuckoo_cityhash), way> 
 		filter(cuckoo_cityhash, capacity);
 
+	PerfCounters insert_perf;
+	PerfCounters query_perf;
+
+	if (perf_mode) {
+		insert_perf.start();
+	}
 	size_t insert_count = 0;
 	for (auto x : element_sequence) {
 		if (filter.insert(x)) {
 			insert_count += 1;
 		}
 	}
-
+	if (perf_mode) {
+		insert_perf.stop();
+		query_perf.start();
+	}
 	size_t fp_count = 0;
-	for (size_t loop = 0; loop < num_fp_test; loop++) {
-		uint32_t x;
-		do {
-			x = generate_rand();
-		} while (element_set.count(x));
-
+	for (auto x : fp_sequence) {
 		if (filter.query(x)) {
 			fp_count += 1;
 		}
 	}
-    log_info("%d %.5f %.5f\n",
+	if (perf_mode) {
+		query_perf.stop();
+	}
+
+    log_info("%d %.5f %.5f",
             (int) log2(capacity),
             (float) insert_count / capacity,
             (float) fp_count / num_fp_test);
+	if (perf_mode) {
+		log_perf(insert_perf, element_sequence.size());
+		log_perf(query_perf, fp_sequence.size());
+	}
+	log_info("%s", "\n");
 /* log_info("load_factor: %.5f\n", (float) insert_count / capacity); */
 /* log_info("ideal_load_factor: %.5f\n", (float) num_elem / capacity); */
 /* log_info("FP_rate: %.5f\n", (float) fp_count / num_fp_test); */
 }
 
-int main()
+int main(int argc, char *argv[])
 {
-/* template<int capacity, int bits_per_key, int way, int num_elem> */
-/* run_benchmark< 1 << 10,      12,       4,        1 << 10 >(); */
-	run_benchmark< 1 << 10,      12,    8,        1 << 10 >();
-	run_benchmark< 1 << 12,      12,    8,        1 << 12 >();
-	run_benchmark< 1 << 14,      12,    8,        1 << 14 >();
-	run_benchmark< 1 << 16,      12,    8,        1 << 16 >();
-	run_benchmark< 1 << 18,      12,    8,        1 << 18 >();
-	run_benchmark< 1 << 20,      12,    8,        1 << 20 >();
-	run_benchmark< 1 << 22,      12,    8,        1 << 22 >();
-	run_benchmark< 1 << 24,      12,    8,        1 << 24 >();
-	run_benchmark< 1 << 26,      12,    8,        1 << 26 >();
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--perf") == 0) {
+			perf_mode = true;
+		} else {
+			fprintf(stderr, "usage: %s [--perf]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (perf_mode) {
+		PerfCounters probe;
+		if (not probe.any_available()) {
+			fprintf(stderr, "perf_event_open is unavailable, counters are reported as nan\n");
+		}
+		// Columns: log2(capacity) load_factor fp_rate, then the per-operation
+		// counters of the insert phase followed by those of the query phase.
+		log_info("%s", "# log2_capacity load_factor fp_rate");
+		for (const char *phase : {"insert", "query"}) {
+			for (int e = 0; e < PerfCounters::kNumEvents; e++) {
+				log_info(" %s:%s", phase, PerfCounters::name(e));
+			}
+		}
+		log_info("%s", "\n");
+	}
+
+/* run_benchmark<bits_per_key, way>(capacity, num_elem); */
+/* run_benchmark<12, 4>(1 << 10, 1 << 10); */
+	run_benchmark<12, 8>(1 << 10, 1 << 10);
+	run_benchmark<12, 8>(1 << 12, 1 << 12);
+	run_benchmark<12, 8>(1 << 14, 1 << 14);
+	run_benchmark<12, 8>(1 << 16, 1 << 16);
+	run_benchmark<12, 8>(1 << 18, 1 << 18);
+	run_benchmark<12, 8>(1 << 20, 1 << 20);
+	run_benchmark<12, 8>(1 << 22, 1 << 22);
+	run_benchmark<12, 8>(1 << 24, 1 << 24);
+	run_benchmark<12, 8>(1 << 26, 1 << 26);
 	return 0;
 }
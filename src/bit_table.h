@@ -15,8 +15,12 @@
 
 /**
  * @param bits_per_elem Number of bits of an element.
+ * @param track_occupancy Keep a bitmap of the non-empty slots at the end of
+ *        each bucket, so that inserts find a free slot without scanning,
+ *        queries only compare the non-empty slots and skip empty buckets, and
+ *        load() is a popcount.
  */
-template<int bits_per_elem, int elems_per_bucket = 4>
+template<int bits_per_elem, int elems_per_bucket = 4, bool track_occupancy = false>
 class BitTable
 {
 
@@ -30,11 +34,13 @@ public:
     static_assert(bits_per_elem == 2 || bits_per_elem == 4 || bits_per_elem == 8 ||
 	          bits_per_elem == 12 || bits_per_elem == 16 || bits_per_elem == 32,
 	    "BitTable only support bits_per_elem in {2, 4, 8, 12, 16, 32}");
+    static_assert(!track_occupancy || elems_per_bucket <= 64,
+            "occupancy bitmap supports at most 64 elements per bucket");
 
     class Bucket
     {
     public:
-        uint8_t bits_[BitTable::kBytesPerBucket];
+        uint8_t bits_[BitTable::kBucketBytes];
     } __attribute__((__packed__));
 
     BitTable(size_t num_buckets)
@@ -44,7 +50,7 @@ public:
         size_t size = num_buckets_ + kBucketsPadding;
 	/* log_debug("table size: %zu, bucket size: %zu\n", size, kBytesPerBucket); */
         bucket_ = new Bucket[size];
-        static_assert(sizeof(Bucket) == kBytesPerBucket,
+        static_assert(sizeof(Bucket) == kBucketBytes,
                 "Bucket is not in packed form");
         memset(bucket_, 0, size * sizeof(Bucket)); 
     }
@@ -54,6 +60,11 @@ public:
         delete[] bucket_;
     }
 
+    inline size_t num_buckets() const
+    {
+        return num_buckets_;
+    }
+
     /**
      * Get the j-th element in the i-th bucket.
      * Adapted from: https://github.com/efficient/cuckoofilter/blob/aac6569cf30f0dfcf39edec1799fc3f8d6f594da/src/singletable.h
@@ -65,7 +76,7 @@ public:
         /* following code only works for little-endian */
         if (bits_per_elem == 2) {
             p += (j >> 2);
-            tag = *((uint8_t *)p) >> (j * 2);
+            tag = *((uint8_t *)p) >> ((j & 3) << 1);
         } else if (bits_per_elem == 4) {
             p += (j >> 1);
             tag = *((uint8_t *)p) >> ((j & 1) << 2);
@@ -88,6 +99,14 @@ public:
         return result;
     }
 
+    /**
+     * Prefetch the i-th bucket into the cache.
+     */
+    inline void prefetch(size_t i) const
+    {
+        __builtin_prefetch(&bucket_[i]);
+    }
+
     /**
      * Insert element t into the j-th slot in the i-th bucket.
      * @param t    The element to insert. It will be truncated to bits_per_elem bits.
@@ -100,8 +119,8 @@ public:
         /* following code only works for little-endian */
         if (bits_per_elem == 2) {
             p += (j >> 2);
-            *((uint8_t *)p) &= ~(kElemMask << (2 * j));
-            *((uint8_t *)p) |= elem << (2 * j);
+            *((uint8_t *)p) &= ~(kElemMask << ((j & 3) << 1));
+            *((uint8_t *)p) |= elem << ((j & 3) << 1);
         } else if (bits_per_elem == 4) {
             p += (j >> 1);
             if ((j & 1) == 0) {
@@ -127,6 +146,30 @@ public:
         } else if (bits_per_elem == 32) {
             ((uint32_t *)p)[j] = elem;
         }
+        if (track_occupancy) {
+            uint64_t occupied = occupancy(i);
+            if (elem) {
+                occupied |= 1ull << j;
+            } else {
+                occupied &= ~(1ull << j);
+            }
+            set_occupancy(i, occupied);
+        }
+    }
+
+    /**
+     * @return The number of non-empty slots in the i-th bucket.
+     */
+    inline int load(size_t i) const
+    {
+        if (track_occupancy) {
+            return __builtin_popcountll(occupancy(i));
+        }
+        int n = 0;
+        for (int j = 0; j < elems_per_bucket; j++) {
+            n += get_elem(i, j) != 0;
+        }
+        return n;
     }
 
     /**
@@ -136,11 +179,19 @@ public:
      */
     inline bool insert_elem(size_t i, elem_type elem, bool kick, elem_type *last) 
     {
-        for (int j = 0; j < elems_per_bucket; j++) {
-            if (get_elem(i, j) == 0) {
-                set_elem(i, j, elem);
+        if (track_occupancy) {
+            uint64_t empty = ~occupancy(i) & kFullMask;
+            if (empty) {
+                set_elem(i, __builtin_ctzll(empty), elem);
                 return true;
             }
+        } else {
+            for (int j = 0; j < elems_per_bucket; j++) {
+                if (get_elem(i, j) == 0) {
+                    set_elem(i, j, elem);
+                    return true;
+                }
+            }
         }
         if (kick) {
             int j = this->rand() % elems_per_bucket;
@@ -156,33 +207,59 @@ public:
      */
     inline bool delete_elem(size_t i, elem_type elem) 
     {
-        elem &= kElemMask;
-        for (int j = 0; j < elems_per_bucket; j++) {
-            if (get_elem(i, j) == elem) {
-                set_elem(i, j, 0);
-                return true;
-            }
+        int j = find_elem(i, elem, kElemMask);
+        if (j >= 0) {
+            set_elem(i, j, 0);
+            return true;
         }
         return false;
     }
 
-    inline bool query_elem(size_t i, elem_type elem)
+    /**
+     * Find an element in the i-th bucket comparing only the bits in mask.
+     * With track_occupancy, only the non-empty slots are compared.
+     * @return The slot of the first matching element, or -1 if there is none.
+     */
+    inline int find_elem(size_t i, elem_type elem, elem_type mask) const
     {
-        elem &= kElemMask;
+        elem &= mask;
+        if (track_occupancy) {
+            for (uint64_t m = occupancy(i); m; m &= m - 1) {
+                int j = __builtin_ctzll(m);
+                if ((get_elem(i, j) & mask) == elem) {
+                    return j;
+                }
+            }
+            return -1;
+        }
         for (int j = 0; j < elems_per_bucket; j++) {
-            if (get_elem(i, j) == elem) {
-                return true;
+            if ((get_elem(i, j) & mask) == elem) {
+                return j;
             }
         }
-        return false;
+        return -1;
+    }
+
+    inline bool query_elem(size_t i, elem_type elem)
+    {
+        return find_elem(i, elem, kElemMask) >= 0;
     }
 
 private:
     static constexpr size_t kBytesPerBucket =
         round_up(bits_per_elem * elems_per_bucket, 8) / 8;
 
+    static constexpr size_t kOccupancyBytes =
+        track_occupancy ? round_up(elems_per_bucket, 8) / 8 : 0;
+
+    // The occupancy bitmap follows the elements in the same bucket.
+    static constexpr size_t kBucketBytes = kBytesPerBucket + kOccupancyBytes;
+
     static constexpr size_t kBucketsPadding =
-	((((kBytesPerBucket + 7) / 8) * 8) - 1) / kBytesPerBucket;
+	((((kBucketBytes + 7) / 8) * 8) - 1) / kBucketBytes;
+
+    static constexpr uint64_t kFullMask = elems_per_bucket >= 64 ?
+        ~(uint64_t) 0 : ((uint64_t) 1 << elems_per_bucket) - 1;
 
     static constexpr elem_type kElemMask = (1l << bits_per_elem) - 1;
 
@@ -199,6 +276,19 @@ private:
     {
         return rng_();
     }
+
+    /* following code only works for little-endian */
+    inline uint64_t occupancy(size_t i) const
+    {
+        uint64_t occupied = 0;
+        memcpy(&occupied, bucket_[i].bits_ + kBytesPerBucket, kOccupancyBytes);
+        return occupied;
+    }
+
+    inline void set_occupancy(size_t i, uint64_t occupied)
+    {
+        memcpy(bucket_[i].bits_ + kBytesPerBucket, &occupied, kOccupancyBytes);
+    }
 };
 
 #endif // COLOR4_BIT_TABLE_H
@@ -54,3 +54,27 @@ TEST_F(BitTableTest, Kick)
     EXPECT_NE(0, last);
     EXPECT_FALSE(table.insert_elem(7, 2, false, &last));
 }
+
+TEST_F(BitTableTest, Occupancy)
+{
+    BitTable<12, 4, true> table(5);
+    uint32_t last = 0;
+    EXPECT_EQ(0, table.load(3));
+    EXPECT_FALSE(table.query_elem(3, 0));
+    EXPECT_TRUE(table.insert_elem(3, 0xfff, false, &last));
+    EXPECT_TRUE(table.insert_elem(3, 2, false, &last));
+    EXPECT_TRUE(table.insert_elem(3, 3, false, &last));
+    EXPECT_EQ(3, table.load(3));
+    EXPECT_EQ(0, table.load(2));
+    EXPECT_EQ(0, table.load(4));
+    EXPECT_TRUE(table.delete_elem(3, 2));
+    EXPECT_EQ(2, table.load(3));
+    EXPECT_EQ(0, table.get_elem(3, 1));
+    EXPECT_EQ(2, table.find_elem(3, 3, 0xfff));
+    EXPECT_TRUE(table.insert_elem(3, 4, false, &last));
+    EXPECT_EQ(4, table.get_elem(3, 1));
+    EXPECT_TRUE(table.insert_elem(3, 5, true, &last));
+    EXPECT_FALSE(table.insert_elem(3, 6, true, &last));
+    EXPECT_NE(0, last);
+    EXPECT_EQ(4, table.load(3));
+}
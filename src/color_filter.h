@@ -0,0 +1,225 @@
+#ifndef COLOR4_COLOR_FILTER_H
+#define COLOR4_COLOR_FILTER_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <stdlib.h>
+#include <stdint.h>
+#include <type_traits>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <initializer_list>
+
+#include "utils.h"
+#include "bit_table.h"
+#include "table_codec.h"
+
+/**
+ * A cuckoo filter that stores a small value ("color") next to each
+ * fingerprint, i.e. an approximate map from keys to colors. A slot holds
+ * (fingerprint << bits_per_value) | color, so the color is read from the same
+ * bucket that matched the fingerprint and no second lookup is needed.
+ *
+ * Like the membership filter, lookups of keys that were never inserted may
+ * succeed (false positive) and then return an arbitrary color. A key whose
+ * fingerprint collides with another key in the same bucket may read that
+ * key's color, but every inserted key keeps its own entry, so removing one
+ * key never makes another one disappear.
+ *
+ * @param bits_per_key   The fingerprint length.
+ * @param bits_per_value The color length. bits_per_key + bits_per_value must
+ *                       be a slot width supported by BitTable.
+ */
+template<int bits_per_key, int bits_per_value, class Key, class Hash, int way = 4>
+class ColorFilter
+{
+public:
+    static_assert(std::is_same<size_t, decltype(std::declval<Hash>()(std::declval<Key>()))>::value,
+            "The hash function needs to return size_t");
+    static_assert(bits_per_value > 0, "bits_per_value must be greater than zero");
+
+    using value_type = uint32_t;
+
+    ColorFilter(Hash hash, size_t max_num_keys)
+        : hash_(hash)
+    {
+        num_buckets_ = upperpower2(std::max<size_t>(1, max_num_keys / way));
+        table_ = new BitTable<bits_per_key + bits_per_value, way>(num_buckets_);
+    }
+
+    ~ColorFilter()
+    {
+        delete table_;
+    }
+
+    /**
+     * Map v to value. Like CuckooFilter::insert, it always adds a new entry;
+     * use update() to change the value of a key already in the filter.
+     * @param value It will be truncated to bits_per_value bits.
+     */
+    bool insert(const Key &v, value_type value)
+    {
+        size_t h;
+        size_t fp;
+        generate_hash(v, &h, &fp);
+
+        uint32_t elem = make_elem(fp, value);
+        for (int i = 0; i < kMaxKick; i++) {
+            bool kick = i > 0;
+            uint32_t last;
+
+            if (table_->insert_elem(h, elem, kick, &last)) {
+                return true;
+            }
+
+            if (kick) {
+                elem = last;
+                fp = last >> bits_per_value;
+            }
+
+            h = xor_hash_fp(h, fp);
+        }
+        return false;
+    }
+
+    /**
+     * @param value Set to the value of v if v is found.
+     * @return True if v is (probably) in the filter.
+     */
+    bool lookup(const Key &v, value_type *value) const
+    {
+        size_t h;
+        size_t fp;
+        generate_hash(v, &h, &fp);
+        size_t h2 = xor_hash_fp(h, fp);
+
+        if (find(h, fp, value) || find(h2, fp, value)) {
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Change the value of v without moving it.
+     * @return False if v is not in the filter.
+     */
+    bool update(const Key &v, value_type value)
+    {
+        size_t h;
+        size_t fp;
+        generate_hash(v, &h, &fp);
+        return update_elem(h, fp, value);
+    }
+
+    void remove(const Key &v)
+    {
+        size_t h1;
+        size_t fp;
+        generate_hash(v, &h1, &fp);
+
+        for (size_t h : {h1, xor_hash_fp(h1, fp)}) {
+            int j = table_->find_elem(h, fp << bits_per_value, kKeyMask);
+            if (j >= 0) {
+                table_->set_elem(h, j, 0);
+                return;
+            }
+        }
+    }
+
+    /**
+     * Write the table in the compact transfer format of TableCodec.
+     * kSortedDelta is rejected: it reorders the slots of a bucket, which
+     * changes the color that colliding keys read.
+     * @return The number of bytes written.
+     */
+    size_t export_table(std::ostream &out,
+            TableCodec::Encoding encoding = TableCodec::kAuto) const
+    {
+        if (encoding == TableCodec::kSortedDelta) {
+            throw std::runtime_error("ColorFilter: kSortedDelta does not keep the slot order");
+        }
+        return TableCodec::encode(*table_, out, encoding);
+    }
+
+    /**
+     * Replace the table with an image from export_table() of a filter that
+     * has the same hash function and max_num_keys.
+     */
+    void import_table(std::istream &in)
+    {
+        TableCodec::decode(in, table_);
+    }
+
+private:
+
+    static constexpr uint32_t kValueMask = (1u << bits_per_value) - 1;
+
+    static constexpr uint32_t kKeyMask = ((1ul << bits_per_key) - 1) << bits_per_value;
+
+    static inline uint32_t make_elem(size_t fp, value_type value)
+    {
+        return (fp << bits_per_value) | (value & kValueMask);
+    }
+
+    inline bool find(size_t h, size_t fp, value_type *value) const
+    {
+        int j = table_->find_elem(h, fp << bits_per_value, kKeyMask);
+        if (j < 0) {
+            return false;
+        }
+        *value = table_->get_elem(h, j) & kValueMask;
+        return true;
+    }
+
+    inline bool update_elem(size_t h1, size_t fp, value_type value)
+    {
+        for (size_t h : {h1, xor_hash_fp(h1, fp)}) {
+            int j = table_->find_elem(h, fp << bits_per_value, kKeyMask);
+            if (j >= 0) {
+                table_->set_elem(h, j, make_elem(fp, value));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void generate_hash(const Key& key, size_t* h1, size_t* fp) const
+    {
+        size_t h = hash_(key);
+
+        size_t ha;
+        if (sizeof(size_t) == 4) {
+            // equivalent to (h % num_buckets_)
+            ha = h & (num_buckets_ - 1);
+        } else {
+            ha = (h >> 32) & (num_buckets_ - 1);
+        }
+        *h1 = ha;
+
+        size_t hb = h & ((1l << bits_per_key) - 1);
+        if (hb == 0) {
+            // 0 is reserved to mark the empty slot in the bucket.
+            *fp = 1;
+        } else {
+            *fp = hb;
+        }
+    }
+
+    inline size_t xor_hash_fp(size_t h, size_t fp) const
+    {
+        size_t h1 = (h ^ ((uint32_t) fp * 0x5bd1e995));
+        return h1 & (num_buckets_ - 1);
+    }
+
+    Hash hash_;
+
+    size_t num_buckets_;
+
+    static constexpr int kMaxKick = 500;
+
+    BitTable<bits_per_key + bits_per_value, way> *table_;
+
+};
+
+#endif // COLOR4_COLOR_FILTER_H
@@ -0,0 +1,105 @@
+#include "color_filter.h"
+#include "gtest/gtest.h"
+#include "test_hash.h"
+#include <cstdint>
+
+class ColorFilterTest : public ::testing::Test
+{
+
+public:
+    static size_t hash_c23(int x) {
+        return x * 23 * x * 123498711111;
+    }
+
+    static size_t hash_mix(int x) {
+        return splitmix64(x);
+    }
+};
+
+TEST_F(ColorFilterTest, OneElement)
+{
+    ColorFilter<12, 4, int, size_t (*)(int)> filter(hash_c23, 100);
+    const int e1 = 9823147;
+    const int e2 = 4231678;
+    uint32_t value = 0;
+    EXPECT_TRUE(filter.insert(e1, 3));
+    EXPECT_TRUE(filter.lookup(e1, &value));
+    EXPECT_EQ(3, value);
+    EXPECT_FALSE(filter.lookup(e2, &value));
+    EXPECT_FALSE(filter.update(e2, 5));
+
+    EXPECT_TRUE(filter.update(e1, 0));
+    EXPECT_TRUE(filter.lookup(e1, &value));
+    EXPECT_EQ(0, value);
+
+    EXPECT_TRUE(filter.update(e1, 9));
+    EXPECT_TRUE(filter.lookup(e1, &value));
+    EXPECT_EQ(9, value);
+
+    filter.remove(e1);
+    EXPECT_FALSE(filter.lookup(e1, &value));
+}
+
+TEST_F(ColorFilterTest, ManyElements)
+{
+    const int n = 3000;
+    ColorFilter<12, 4, int, size_t (*)(int)> filter(hash_mix, 4096);
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(filter.insert(i, i % 16));
+    }
+    for (int i = 0; i < n; i += 2) {
+        filter.remove(i);
+    }
+    // Removing a key must not remove another key of the same fingerprint.
+    int wrong = 0;
+    for (int i = 1; i < n; i += 2) {
+        uint32_t value;
+        ASSERT_TRUE(filter.lookup(i, &value)) << i;
+        wrong += value != (uint32_t) i % 16;
+    }
+    // A key may read the color of another key with the same fingerprint in
+    // one of its 8 candidate slots, with probability about 8 / 2^12.
+    EXPECT_LE(wrong, 10);
+}
+
+TEST_F(ColorFilterTest, FingerprintCollision)
+{
+    // 8-bit fingerprints in a small table, so that many keys collide.
+    const int n = 3000;
+    ColorFilter<8, 4, int, size_t (*)(int)> filter(hash_mix, 4096);
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(filter.insert(i, i % 16));
+    }
+    for (int i = 0; i < n; i += 2) {
+        filter.remove(i);
+    }
+    int wrong = 0;
+    for (int i = 1; i < n; i += 2) {
+        uint32_t value;
+        ASSERT_TRUE(filter.lookup(i, &value)) << i;
+        wrong += value != (uint32_t) i % 16;
+    }
+    // About 8 / 2^8 of the keys.
+    EXPECT_LE(wrong, 60);
+}
+
+TEST_F(ColorFilterTest, Update)
+{
+    const int n = 3000;
+    ColorFilter<12, 4, int, size_t (*)(int)> filter(hash_mix, 4096);
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(filter.insert(i, i % 16));
+    }
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(filter.update(i, 15 - i % 16)) << i;
+    }
+    int wrong = 0;
+    for (int i = 0; i < n; i++) {
+        uint32_t value;
+        ASSERT_TRUE(filter.lookup(i, &value)) << i;
+        wrong += value != (uint32_t) (15 - i % 16);
+    }
+    // As in ManyElements, only keys with a colliding fingerprint may differ.
+    EXPECT_LE(wrong, 10);
+    EXPECT_FALSE(filter.update(n + 12345, 1));
+}
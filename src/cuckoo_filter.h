@@ -9,11 +9,18 @@
 #include <stdint.h>
 #include <type_traits>
 #include <algorithm>
+#include <istream>
+#include <ostream>
 
 #include "utils.h"
 #include "bit_table.h"
+#include "table_codec.h"
 
-template<int bits_per_key, class Key, class Hash, int way = 4>
+/**
+ * @param track_occupancy Keep per-bucket occupancy bitmaps in the table, and
+ *        insert into the less loaded of the two candidate buckets.
+ */
+template<int bits_per_key, class Key, class Hash, int way = 4, bool track_occupancy = false>
 class CuckooFilter 
 {
 public:
@@ -24,7 +31,7 @@ public:
         : hash_(hash)
     {
         num_buckets_ = upperpower2(std::max<size_t>(1, max_num_keys / way));
-        table_ = new BitTable<bits_per_key, way>(num_buckets_);
+        table_ = new BitTable<bits_per_key, way, track_occupancy>(num_buckets_);
     }
 
     ~CuckooFilter() 
@@ -37,6 +44,12 @@ public:
         size_t h;
         size_t fp;
         generate_hash(v, &h, &fp);
+        if (track_occupancy) {
+            size_t h2 = xor_hash_fp(h, fp);
+            if (table_->load(h2) < table_->load(h)) {
+                h = h2;
+            }
+        }
         for (int i = 0; i < kMaxKick; i++) {
             bool kick = i > 0;
             uint32_t last;
@@ -87,6 +100,25 @@ public:
         }
     }
 
+    /**
+     * Write the table in the compact transfer format of TableCodec.
+     * @return The number of bytes written.
+     */
+    size_t export_table(std::ostream &out,
+            TableCodec::Encoding encoding = TableCodec::kAuto) const
+    {
+        return TableCodec::encode(*table_, out, encoding);
+    }
+
+    /**
+     * Replace the table with an image from export_table() of a filter that
+     * has the same hash function and max_num_keys.
+     */
+    void import_table(std::istream &in)
+    {
+        TableCodec::decode(in, table_);
+    }
+
 private:
 
     inline void generate_hash(const Key& key, size_t* h1, size_t* fp)
@@ -128,7 +160,7 @@ private:
 
     static constexpr int kMaxKick = 500;
 
-    BitTable<bits_per_key, way> *table_;
+    BitTable<bits_per_key, way, track_occupancy> *table_;
 
 };
 
@@ -28,3 +28,21 @@ TEST_F(CuckooFilterTest, OneElement)
     EXPECT_FALSE(filter.query(e1));
     EXPECT_FALSE(filter.query(e2));
 }
+
+TEST_F(CuckooFilterTest, TrackOccupancy)
+{
+    CuckooFilter<16, int, size_t (*)(int), 4, true> filter(hash_c23, 1 << 12);
+    const int n = (1 << 12) * 9 / 10;
+    for (int i = 1; i <= n; i++) {
+        ASSERT_TRUE(filter.insert(i));
+    }
+    for (int i = 1; i <= n; i++) {
+        EXPECT_TRUE(filter.query(i));
+    }
+    for (int i = 1; i <= n; i += 2) {
+        filter.remove(i);
+    }
+    for (int i = 2; i <= n; i += 2) {
+        EXPECT_TRUE(filter.query(i));
+    }
+}
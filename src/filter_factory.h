@@ -0,0 +1,307 @@
+#ifndef COLOR4_FILTER_FACTORY_H
+#define COLOR4_FILTER_FACTORY_H
+
+#include <cstdint>
+#include <math.h>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "utils.h"
+#include "cuckoo_filter.h"
+#include "quotient_filter.h"
+#include "yeah_filter.h"
+
+/**
+ * A filter layout chosen at run time, together with its estimated cost.
+ */
+struct FilterConfig
+{
+    enum Type {
+        kCuckoo,
+        kYeah,
+        kQuotient
+    };
+
+    Type type;
+
+    int bits_per_key;
+
+    /// The number of fingerprints in a bucket. 1 for the quotient filter.
+    int way;
+
+    /// The dimension of the bucket space. 1 for the cuckoo filter, and 0
+    /// for the quotient filter, which has no buckets. create() matches it.
+    int dim;
+
+    /// The max_num_keys passed to the filter constructor.
+    size_t max_num_keys;
+
+    /// The expected false positive rate with the expected number of keys.
+    double fpr;
+
+    /// The size of the table in bytes.
+    size_t memory_bytes;
+
+    /// The number of buckets probed by a negative query.
+    int probes;
+};
+
+/**
+ * The type-erased interface of a filter. The batch operations make one
+ * virtual call per batch, and loop over the concrete filter inside.
+ */
+template<class Key>
+class Filter
+{
+public:
+    virtual ~Filter() {}
+
+    virtual bool insert(const Key &key) = 0;
+
+    virtual bool query(const Key &key) = 0;
+
+    virtual void remove(const Key &key) = 0;
+
+    /**
+     * @return The number of keys inserted successfully.
+     */
+    virtual size_t insert_batch(const Key *keys, size_t n) = 0;
+
+    /**
+     * Set result[i] to query(keys[i]).
+     * @return The number of positive results.
+     */
+    virtual size_t query_batch(const Key *keys, size_t n, bool *result) = 0;
+
+    virtual void remove_batch(const Key *keys, size_t n) = 0;
+
+    virtual const FilterConfig &config() const = 0;
+};
+
+/**
+ * Implement Filter with a concrete filter type.
+ */
+template<class Impl, class Key, class Hash>
+class FilterAdapter final : public Filter<Key>
+{
+public:
+    FilterAdapter(Hash hash, const FilterConfig &config)
+        : impl_(hash, config.max_num_keys), config_(config)
+    {
+    }
+
+    bool insert(const Key &key) override
+    {
+        return impl_.insert(key);
+    }
+
+    bool query(const Key &key) override
+    {
+        return impl_.query(key);
+    }
+
+    void remove(const Key &key) override
+    {
+        impl_.remove(key);
+    }
+
+    size_t insert_batch(const Key *keys, size_t n) override
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) {
+            count += impl_.insert(keys[i]);
+        }
+        return count;
+    }
+
+    size_t query_batch(const Key *keys, size_t n, bool *result) override
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) {
+            result[i] = impl_.query(keys[i]);
+            count += result[i];
+        }
+        return count;
+    }
+
+    void remove_batch(const Key *keys, size_t n) override
+    {
+        for (size_t i = 0; i < n; i++) {
+            impl_.remove(keys[i]);
+        }
+    }
+
+    const FilterConfig &config() const override
+    {
+        return config_;
+    }
+
+private:
+    Impl impl_;
+
+    FilterConfig config_;
+};
+
+/**
+ * The precompiled filter instantiations a FilterFactory can choose from.
+ */
+template<class Key, class Hash>
+class FilterFactory
+{
+public:
+    /**
+     * @return Every precompiled layout sized for num_keys keys, with its
+     * estimated false positive rate and memory.
+     */
+    static std::vector<FilterConfig> configs(size_t num_keys)
+    {
+        std::vector<FilterConfig> result;
+        for (const Entry &e : entries()) {
+            result.push_back(estimate(e, std::max<size_t>(1, num_keys)));
+        }
+        return result;
+    }
+
+    /**
+     * Pick the smallest layout whose expected false positive rate does not
+     * exceed target_fpr; among equally small ones, the one with fewer probes.
+     * If none qualifies, pick the most accurate one.
+     */
+    static FilterConfig choose(size_t num_keys, double target_fpr)
+    {
+        std::vector<FilterConfig> all = configs(num_keys);
+        const FilterConfig *best = nullptr;
+        for (const FilterConfig &c : all) {
+            if (c.fpr > target_fpr) {
+                continue;
+            }
+            if (best == nullptr || c.memory_bytes < best->memory_bytes ||
+                    (c.memory_bytes == best->memory_bytes && c.probes < best->probes)) {
+                best = &c;
+            }
+        }
+        if (best == nullptr) {
+            best = &*std::min_element(all.begin(), all.end(),
+                    [](const FilterConfig &a, const FilterConfig &b) {
+                        return a.fpr < b.fpr;
+                    });
+        }
+        return *best;
+    }
+
+    static std::unique_ptr<Filter<Key>> create(Hash hash, size_t num_keys, double target_fpr)
+    {
+        return create(hash, choose(num_keys, target_fpr));
+    }
+
+    /**
+     * @param config One of configs(). Throws if it is not precompiled.
+     */
+    static std::unique_ptr<Filter<Key>> create(Hash hash, const FilterConfig &config)
+    {
+        for (const Entry &e : entries()) {
+            if (e.type == config.type && e.bits_per_key == config.bits_per_key &&
+                    e.way == config.way && e.dim == config.dim) {
+                return std::unique_ptr<Filter<Key>>(e.create(hash, config));
+            }
+        }
+        throw std::runtime_error("FilterFactory: the configuration is not precompiled");
+    }
+
+private:
+
+    struct Entry
+    {
+        FilterConfig::Type type;
+        int bits_per_key;
+        int way;
+        int dim;
+        /// The load factor at which insertions start to fail.
+        double max_load_factor;
+        Filter<Key> *(*create)(Hash hash, const FilterConfig &config);
+    };
+
+    template<class Impl>
+    static Filter<Key> *make(Hash hash, const FilterConfig &config)
+    {
+        return new FilterAdapter<Impl, Key, Hash>(hash, config);
+    }
+
+    template<int bits_per_key, int way>
+    static Entry cuckoo(double max_load_factor)
+    {
+        return {FilterConfig::kCuckoo, bits_per_key, way, 1, max_load_factor,
+            &make<CuckooFilter<bits_per_key, Key, Hash, way>>};
+    }
+
+    template<int bits_per_key, int way, int dim>
+    static Entry yeah(double max_load_factor)
+    {
+        return {FilterConfig::kYeah, bits_per_key, way, dim, max_load_factor,
+            &make<YeahFilter<bits_per_key, Key, Hash, way, dim>>};
+    }
+
+    template<int bits_per_key>
+    static Entry quotient()
+    {
+        return {FilterConfig::kQuotient, bits_per_key, 1, 0, 0.95,
+            &make<QuotientFilter<bits_per_key, Key, Hash>>};
+    }
+
+    /**
+     * The load factors are measured at 2^18 slots, where insertion first
+     * fails, and rounded down to leave a margin.
+     */
+    static const std::vector<Entry> &entries()
+    {
+        static const std::vector<Entry> kEntries = {
+            cuckoo<8, 2>(0.84), cuckoo<8, 4>(0.94), cuckoo<8, 8>(0.97),
+            cuckoo<12, 2>(0.84), cuckoo<12, 4>(0.94), cuckoo<12, 8>(0.97),
+            cuckoo<16, 2>(0.84), cuckoo<16, 4>(0.94), cuckoo<16, 8>(0.97),
+            cuckoo<32, 4>(0.94),
+            yeah<8, 2, 2>(0.96), yeah<12, 2, 2>(0.96), yeah<16, 2, 2>(0.96),
+            yeah<8, 4, 2>(0.97), yeah<12, 4, 2>(0.97), yeah<16, 4, 2>(0.97),
+            yeah<12, 4, 3>(0.98), yeah<16, 4, 3>(0.98),
+            quotient<8>(), quotient<12>(), quotient<16>(),
+        };
+        return kEntries;
+    }
+
+    static FilterConfig estimate(const Entry &e, size_t num_keys)
+    {
+        FilterConfig c;
+        c.type = e.type;
+        c.bits_per_key = e.bits_per_key;
+        c.way = e.way;
+        c.dim = e.dim;
+        c.max_num_keys = (size_t) ceil(num_keys / e.max_load_factor);
+
+        double load;
+        if (e.type == FilterConfig::kQuotient) {
+            // See QuotientFilter::quotient_bits_for.
+            c.max_num_keys = num_keys;
+            size_t num_slots = upperpower2(std::max<size_t>(64,
+                        (size_t) (num_keys / e.max_load_factor) + 1));
+            load = (double) num_keys / num_slots;
+            // A query matches each remainder of its run with probability 2^-r.
+            c.fpr = 1 - exp(-load / pow(2, e.bits_per_key));
+            c.memory_bytes = num_slots * (e.bits_per_key + 3) / kBitsPerByte;
+            c.probes = 1;
+        } else {
+            size_t num_buckets = upperpower2(std::max<size_t>(1, c.max_num_keys / e.way));
+            load = (double) num_keys / (num_buckets * e.way);
+            c.probes = 1 << e.dim;
+            // Each of the probed slots holds a random non-zero fingerprint
+            // with probability load.
+            double p = 1.0 / (pow(2, e.bits_per_key) - 1);
+            c.fpr = 1 - pow(1 - p, c.probes * e.way * load);
+            c.memory_bytes = num_buckets * round_up(e.bits_per_key * e.way, 8) / kBitsPerByte;
+        }
+        return c;
+    }
+};
+
+#endif // COLOR4_FILTER_FACTORY_H
@@ -0,0 +1,93 @@
+#include "filter_factory.h"
+#include "gtest/gtest.h"
+#include "test_hash.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class FilterFactoryTest : public ::testing::Test
+{
+
+public:
+    static size_t hash_mix(int x) {
+        return splitmix64(x);
+    }
+
+    using Factory = FilterFactory<int, size_t (*)(int)>;
+};
+
+TEST_F(FilterFactoryTest, Choose)
+{
+    const size_t n = 100000;
+    FilterConfig loose = Factory::choose(n, 0.05);
+    FilterConfig tight = Factory::choose(n, 0.0001);
+    EXPECT_LE(loose.fpr, 0.05);
+    EXPECT_LE(tight.fpr, 0.0001);
+    EXPECT_LT(loose.memory_bytes, tight.memory_bytes);
+    EXPECT_LT(loose.bits_per_key, tight.bits_per_key);
+
+    for (const FilterConfig &c : Factory::configs(n)) {
+        if (c.fpr <= 0.0001) {
+            EXPECT_GE(c.memory_bytes, tight.memory_bytes);
+        }
+    }
+
+    // Unreachable target: the most accurate layout.
+    EXPECT_EQ(32, Factory::choose(n, 0).bits_per_key);
+}
+
+TEST_F(FilterFactoryTest, EveryConfig)
+{
+    const int n = 5000;
+    std::vector<int> keys(n);
+    for (int i = 0; i < n; i++) {
+        keys[i] = i;
+    }
+    std::vector<int> others(n);
+    for (int i = 0; i < n; i++) {
+        others[i] = i + n;
+    }
+    std::unique_ptr<bool[]> result(new bool[n]);
+
+    for (const FilterConfig &c : Factory::configs(n)) {
+        std::unique_ptr<Filter<int>> filter = Factory::create(hash_mix, c);
+        EXPECT_EQ(c.type, filter->config().type);
+        EXPECT_EQ(n, filter->insert_batch(keys.data(), n));
+        EXPECT_EQ(n, filter->query_batch(keys.data(), n, result.get()));
+        size_t fp = filter->query_batch(others.data(), n, result.get());
+        EXPECT_LE(fp, c.fpr * n * 2 + 10);
+
+        filter->remove_batch(keys.data(), n / 2);
+        EXPECT_TRUE(filter->query(n - 1));
+    }
+}
+
+TEST_F(FilterFactoryTest, Create)
+{
+    std::unique_ptr<Filter<int>> filter = Factory::create(hash_mix, 1000, 0.01);
+    EXPECT_LE(filter->config().fpr, 0.01);
+    EXPECT_TRUE(filter->insert(1));
+    EXPECT_TRUE(filter->query(1));
+    filter->remove(1);
+    EXPECT_FALSE(filter->query(1));
+
+    FilterConfig config = filter->config();
+    config.bits_per_key = 5;
+    EXPECT_THROW(Factory::create(hash_mix, config), std::runtime_error);
+}
+
+TEST_F(FilterFactoryTest, HandBuiltConfig)
+{
+    FilterConfig c = {};
+    c.type = FilterConfig::kQuotient;
+    c.bits_per_key = 12;
+    c.way = 1;
+    c.dim = 0;
+    c.max_num_keys = 1000;
+    std::unique_ptr<Filter<int>> filter = Factory::create(hash_mix, c);
+    EXPECT_TRUE(filter->insert(7));
+    EXPECT_TRUE(filter->query(7));
+
+    c.dim = 1;
+    EXPECT_THROW(Factory::create(hash_mix, c), std::runtime_error);
+}
@@ -0,0 +1,188 @@
+#ifndef COLOR4_PERF_COUNTER_H
+#define COLOR4_PERF_COUNTER_H
+
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * Hardware performance counters of the calling thread, read through
+ * perf_event_open(2). Every event is opened separately, so an event that is
+ * not supported by the kernel, the hardware or the current permissions (see
+ * /proc/sys/kernel/perf_event_paranoid) is simply reported as unavailable.
+ * On non-Linux systems all events are unavailable.
+ */
+class PerfCounters
+{
+public:
+    enum Event {
+        kInstructions = 0,
+        kCycles,
+        kCacheMisses,
+        kTlbMisses,
+        kBranchMisses,
+        kNumEvents
+    };
+
+    PerfCounters()
+    {
+        for (int e = 0; e < kNumEvents; e++) {
+            fd_[e] = open_event(e);
+            value_[e] = 0;
+        }
+    }
+
+    ~PerfCounters()
+    {
+        for (int e = 0; e < kNumEvents; e++) {
+            if (fd_[e] >= 0) {
+                close(fd_[e]);
+            }
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    inline bool available(int e) const
+    {
+        return fd_[e] >= 0;
+    }
+
+    inline bool any_available() const
+    {
+        for (int e = 0; e < kNumEvents; e++) {
+            if (available(e)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Reset and start all available counters.
+     */
+    void start()
+    {
+#ifdef __linux__
+        for (int e = 0; e < kNumEvents; e++) {
+            if (available(e)) {
+                ioctl(fd_[e], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd_[e], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /**
+     * Stop all available counters and latch their values.
+     */
+    void stop()
+    {
+#ifdef __linux__
+        for (int e = 0; e < kNumEvents; e++) {
+            if (available(e)) {
+                ioctl(fd_[e], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int e = 0; e < kNumEvents; e++) {
+            value_[e] = available(e) ? read_event(fd_[e]) : 0;
+        }
+#endif
+    }
+
+    /**
+     * @return The value of event e between the last start() and stop().
+     * The value is scaled up if the kernel had to multiplex the counter.
+     */
+    inline uint64_t value(int e) const
+    {
+        return value_[e];
+    }
+
+    static const char *name(int e)
+    {
+        static const char *names[kNumEvents] = {
+            "instructions", "cycles", "cache-misses", "dtlb-misses", "branch-misses"
+        };
+        return names[e];
+    }
+
+private:
+
+    static int open_event(int e)
+    {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch (e) {
+        case kInstructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case kCycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case kCacheMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case kTlbMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case kBranchMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            return -1;
+        }
+
+        // pid = 0 and cpu = -1: measure the calling thread on any cpu.
+        long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        return fd < 0 ? -1 : (int) fd;
+#else
+        (void) e;
+        return -1;
+#endif
+    }
+
+    static uint64_t read_event(int fd)
+    {
+        // value, time_enabled, time_running
+        uint64_t buf[3];
+        if (read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+            return 0;
+        }
+        if (buf[2] == 0) {
+            return 0;
+        }
+        if (buf[2] < buf[1]) {
+            return (uint64_t) ((double) buf[0] * buf[1] / buf[2]);
+        }
+        return buf[0];
+    }
+
+    int fd_[kNumEvents];
+
+    uint64_t value_[kNumEvents];
+};
+
+#endif // COLOR4_PERF_COUNTER_H
@@ -0,0 +1,23 @@
+#include "perf_counter.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+
+TEST(PerfCountersTest, StartStop)
+{
+    PerfCounters perf;
+    perf.start();
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 100000; i++) {
+        sum += i;
+    }
+    perf.stop();
+    for (int e = 0; e < PerfCounters::kNumEvents; e++) {
+        EXPECT_NE(nullptr, PerfCounters::name(e));
+        if (not perf.available(e)) {
+            EXPECT_EQ(0, perf.value(e));
+        }
+    }
+    if (perf.available(PerfCounters::kInstructions)) {
+        EXPECT_GT(perf.value(PerfCounters::kInstructions), 100000);
+    }
+}
@@ -0,0 +1,555 @@
+#ifndef COLOR4_QUOTIENT_FILTER_H
+#define COLOR4_QUOTIENT_FILTER_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <stdlib.h>
+#include <stdint.h>
+#include <type_traits>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <cassert>
+
+#include "utils.h"
+#include "bit_table.h"
+
+/**
+ * A counting quotient filter.
+ * See: Bender et al., "Don't Thrash: How to Cache Your Hash on Flash", VLDB 2012.
+ *
+ * The fingerprint of a key is split into a quotient, which is the canonical
+ * slot of the key, and a remainder, which is stored in the table. The
+ * remainders of one quotient form a sorted run. Runs are kept in the order
+ * of their quotients and are shifted to the right (linear probing) when their
+ * canonical slots are taken, so an operation only touches a few consecutive
+ * slots. Every slot has three metadata bits:
+ *   occupied:     the slot is the canonical slot of some stored key;
+ *   continuation: the slot holds a remainder of the same run as the previous slot;
+ *   shifted:      the slot holds a remainder that is not in its canonical slot.
+ *
+ * The slots are grouped into blocks of 64 so that each metadata bit of a block
+ * is a 64-bit word. Locating a run counts the occupied bits (rank) and finds
+ * the matching run start in the continuation bits (select) word by word
+ * instead of walking slot by slot.
+ *
+ * The full fingerprint can be restored from a slot, so the filter can be
+ * doubled or merged by a linear scan without the original keys. Each doubling
+ * moves one bit from the remainder to the quotient, which doubles the false
+ * positive rate.
+ *
+ * Keys are counted: inserting a key twice stores it twice.
+ *
+ * @param bits_per_key The length of the remainder before any resize.
+ */
+template<int bits_per_key, class Key, class Hash>
+class QuotientFilter
+{
+public:
+    static_assert(std::is_same<size_t, decltype(std::declval<Hash>()(std::declval<Key>()))>::value,
+            "The hash function needs to return size_t");
+
+    QuotientFilter(Hash hash, size_t max_num_keys)
+        : QuotientFilter(hash, quotient_bits_for(max_num_keys), bits_per_key)
+    {
+    }
+
+    ~QuotientFilter()
+    {
+        delete[] blocks_;
+        delete table_;
+    }
+
+    QuotientFilter(const QuotientFilter &) = delete;
+    QuotientFilter &operator=(const QuotientFilter &) = delete;
+
+    /**
+     * @return False if the filter is full. Call resize() to make room.
+     */
+    bool insert(const Key &v)
+    {
+        if (num_elems_ >= capacity()) {
+            return false;
+        }
+        insert_fingerprint(fingerprint(v));
+        return true;
+    }
+
+    bool query(const Key &v) const
+    {
+        return count_fingerprint(fingerprint(v), true) > 0;
+    }
+
+    /**
+     * @return The number of times v has been inserted (may overestimate).
+     */
+    size_t count(const Key &v) const
+    {
+        return count_fingerprint(fingerprint(v), false);
+    }
+
+    /**
+     * Remove one copy of v.
+     * @return True if a matching fingerprint was found and removed.
+     */
+    bool remove(const Key &v)
+    {
+        return remove_fingerprint(fingerprint(v));
+    }
+
+    /**
+     * Double the number of slots by moving every fingerprint into a new table.
+     */
+    void resize()
+    {
+        if (remainder_bits_ <= 1) {
+            throw std::runtime_error("QuotientFilter: no remainder bit left to resize");
+        }
+        QuotientFilter bigger(hash_, quotient_bits_ + 1, remainder_bits_ - 1);
+        for_each_fingerprint([&](size_t f) {
+            bigger.insert_fingerprint(f);
+        });
+        swap(bigger);
+    }
+
+    /**
+     * Insert all fingerprints of other. Both filters must use the same hash
+     * function and the same fingerprint length, i.e. they are created with
+     * equal max_num_keys and possibly resized since. This filter is resized
+     * only if it can not hold the union.
+     */
+    void merge(const QuotientFilter &other)
+    {
+        if (other.quotient_bits_ + other.remainder_bits_ != quotient_bits_ + remainder_bits_) {
+            throw std::runtime_error("QuotientFilter: merging filters with different fingerprint lengths");
+        }
+        if (&other == this) {
+            // Inserting shifts the clusters that for_each_fingerprint walks,
+            // so take the fingerprints out first.
+            std::vector<size_t> fingerprints;
+            fingerprints.reserve(num_elems_);
+            for_each_fingerprint([&](size_t f) {
+                fingerprints.push_back(f);
+            });
+            while (2 * num_elems_ > capacity()) {
+                resize();
+            }
+            for (size_t f : fingerprints) {
+                insert_fingerprint(f);
+            }
+            return;
+        }
+        while (num_elems_ + other.num_elems_ > capacity()) {
+            resize();
+        }
+        other.for_each_fingerprint([&](size_t f) {
+            insert_fingerprint(f);
+        });
+    }
+
+    /// The number of stored fingerprints.
+    inline size_t size() const
+    {
+        return num_elems_;
+    }
+
+    /// The number of fingerprints that can be stored before a resize.
+    inline size_t capacity() const
+    {
+        return (size_t) (num_slots_ * kMaxLoadFactor);
+    }
+
+    inline int remainder_bits() const
+    {
+        return remainder_bits_;
+    }
+
+private:
+
+    static constexpr int kSlotsPerBlock = 64;
+
+    static constexpr double kMaxLoadFactor = 0.95;
+
+    struct Block
+    {
+        uint64_t occupieds;
+        uint64_t continuations;
+        uint64_t shifteds;
+    };
+
+    QuotientFilter(Hash hash, int quotient_bits, int remainder_bits)
+        : hash_(hash),
+          quotient_bits_(quotient_bits),
+          remainder_bits_(remainder_bits),
+          num_elems_(0)
+    {
+        assert(quotient_bits_ + remainder_bits_ <= 64 && "fingerprint is too long");
+        num_slots_ = (size_t) 1 << quotient_bits_;
+        size_t num_blocks = num_slots_ / kSlotsPerBlock;
+        blocks_ = new Block[num_blocks]();
+        table_ = new BitTable<bits_per_key, kSlotsPerBlock>(num_blocks);
+    }
+
+    static int quotient_bits_for(size_t max_num_keys)
+    {
+        size_t n = upperpower2(std::max<size_t>((size_t) kSlotsPerBlock,
+                    (size_t) (max_num_keys / kMaxLoadFactor) + 1));
+        int bits = 0;
+        while (((size_t) 1 << bits) < n) {
+            bits++;
+        }
+        return bits;
+    }
+
+    void swap(QuotientFilter &other)
+    {
+        std::swap(hash_, other.hash_);
+        std::swap(quotient_bits_, other.quotient_bits_);
+        std::swap(remainder_bits_, other.remainder_bits_);
+        std::swap(num_slots_, other.num_slots_);
+        std::swap(num_elems_, other.num_elems_);
+        std::swap(blocks_, other.blocks_);
+        std::swap(table_, other.table_);
+    }
+
+    inline size_t fingerprint(const Key &key) const
+    {
+        return hash_(key) & low_bits(quotient_bits_ + remainder_bits_);
+    }
+
+    static inline uint64_t low_bits(int n)
+    {
+        return n >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << n) - 1;
+    }
+
+    inline size_t next(size_t i) const
+    {
+        return (i + 1) & (num_slots_ - 1);
+    }
+
+    inline size_t prev(size_t i) const
+    {
+        return (i - 1) & (num_slots_ - 1);
+    }
+
+    static inline bool get_bit(uint64_t word, size_t i)
+    {
+        return (word >> (i % kSlotsPerBlock)) & 1;
+    }
+
+    static inline void set_bit(uint64_t *word, size_t i, bool value)
+    {
+        uint64_t mask = (uint64_t) 1 << (i % kSlotsPerBlock);
+        if (value) {
+            *word |= mask;
+        } else {
+            *word &= ~mask;
+        }
+    }
+
+    inline bool is_occupied(size_t i) const
+    {
+        return get_bit(blocks_[i / kSlotsPerBlock].occupieds, i);
+    }
+
+    inline bool is_continuation(size_t i) const
+    {
+        return get_bit(blocks_[i / kSlotsPerBlock].continuations, i);
+    }
+
+    inline bool is_shifted(size_t i) const
+    {
+        return get_bit(blocks_[i / kSlotsPerBlock].shifteds, i);
+    }
+
+    inline bool is_empty(size_t i) const
+    {
+        const Block &b = blocks_[i / kSlotsPerBlock];
+        return not get_bit(b.occupieds | b.continuations | b.shifteds, i);
+    }
+
+    inline void set_occupied(size_t i, bool value)
+    {
+        set_bit(&blocks_[i / kSlotsPerBlock].occupieds, i, value);
+    }
+
+    inline void set_continuation(size_t i, bool value)
+    {
+        set_bit(&blocks_[i / kSlotsPerBlock].continuations, i, value);
+    }
+
+    inline void set_shifted(size_t i, bool value)
+    {
+        set_bit(&blocks_[i / kSlotsPerBlock].shifteds, i, value);
+    }
+
+    inline size_t get_remainder(size_t i) const
+    {
+        return table_->get_elem(i / kSlotsPerBlock, i % kSlotsPerBlock);
+    }
+
+    inline void set_remainder(size_t i, size_t r)
+    {
+        table_->set_elem(i / kSlotsPerBlock, i % kSlotsPerBlock, r);
+    }
+
+    /**
+     * @return The last slot at or before i whose shifted bit is clear, which
+     * is the start of the cluster containing i.
+     */
+    size_t find_cluster_start(size_t i) const
+    {
+        for (;;) {
+            size_t b = i / kSlotsPerBlock;
+            int off = i % kSlotsPerBlock;
+            uint64_t w = ~blocks_[b].shifteds & low_bits(off + 1);
+            if (w) {
+                return b * kSlotsPerBlock + 63 - __builtin_clzll(w);
+            }
+            i = prev(b * kSlotsPerBlock);
+        }
+    }
+
+    /**
+     * @return The number of occupied slots in (from, to].
+     */
+    size_t rank_occupied(size_t from, size_t to) const
+    {
+        size_t n = (to - from) & (num_slots_ - 1);
+        size_t i = next(from);
+        size_t rank = 0;
+        while (n > 0) {
+            int off = i % kSlotsPerBlock;
+            size_t len = std::min<size_t>(n, kSlotsPerBlock - off);
+            uint64_t w = (blocks_[i / kSlotsPerBlock].occupieds >> off) & low_bits(len);
+            rank += __builtin_popcountll(w);
+            n -= len;
+            i = (i + len) & (num_slots_ - 1);
+        }
+        return rank;
+    }
+
+    /**
+     * @return The k-th slot (k >= 1) after i whose continuation bit is clear.
+     */
+    size_t select_run_start(size_t i, size_t k) const
+    {
+        i = next(i);
+        for (;;) {
+            size_t b = i / kSlotsPerBlock;
+            int off = i % kSlotsPerBlock;
+            uint64_t w = ~blocks_[b].continuations >> off;
+            size_t c = __builtin_popcountll(w);
+            if (c >= k) {
+                for (size_t j = 1; j < k; j++) {
+                    w &= w - 1;
+                }
+                return i + __builtin_ctzll(w);
+            }
+            k -= c;
+            i = ((b + 1) * kSlotsPerBlock) & (num_slots_ - 1);
+        }
+    }
+
+    /**
+     * @return The first occupied slot after i. There must be one.
+     */
+    size_t next_occupied(size_t i) const
+    {
+        i = next(i);
+        for (;;) {
+            size_t b = i / kSlotsPerBlock;
+            uint64_t w = blocks_[b].occupieds >> (i % kSlotsPerBlock);
+            if (w) {
+                return i + __builtin_ctzll(w);
+            }
+            i = ((b + 1) * kSlotsPerBlock) & (num_slots_ - 1);
+        }
+    }
+
+    /**
+     * @return The slot where the run of quotient fq starts. fq must be occupied.
+     */
+    inline size_t find_run_start(size_t fq) const
+    {
+        size_t b = find_cluster_start(fq);
+        size_t k = rank_occupied(b, fq);
+        return k == 0 ? b : select_run_start(b, k);
+    }
+
+    size_t count_fingerprint(size_t f, bool any) const
+    {
+        size_t fq = f >> remainder_bits_;
+        size_t fr = f & low_bits(remainder_bits_);
+        if (not is_occupied(fq)) {
+            return 0;
+        }
+
+        size_t s = find_run_start(fq);
+        size_t n = 0;
+        do {
+            size_t r = get_remainder(s);
+            if (r == fr) {
+                n += 1;
+                if (any) {
+                    break;
+                }
+            } else if (r > fr) {
+                break;
+            }
+            s = next(s);
+        } while (is_continuation(s));
+        return n;
+    }
+
+    void insert_fingerprint(size_t f)
+    {
+        size_t fq = f >> remainder_bits_;
+        size_t fr = f & low_bits(remainder_bits_);
+        num_elems_ += 1;
+
+        if (is_empty(fq)) {
+            set_occupied(fq, true);
+            set_remainder(fq, fr);
+            return;
+        }
+
+        bool was_occupied = is_occupied(fq);
+        set_occupied(fq, true);
+        size_t start = find_run_start(fq);
+        size_t s = start;
+        bool continuation = false;
+
+        if (was_occupied) {
+            // Keep the run sorted so that lookups can stop early.
+            do {
+                if (get_remainder(s) > fr) {
+                    break;
+                }
+                s = next(s);
+            } while (is_continuation(s));
+
+            if (s == start) {
+                // The old head of the run will be shifted behind the new one.
+                set_continuation(start, true);
+            } else {
+                continuation = true;
+            }
+        }
+
+        // Shift the rest of the cluster right by one slot. Occupied bits
+        // belong to the slots and stay in place.
+        bool shifted = s != fq;
+        for (;;) {
+            bool empty = is_empty(s);
+            size_t r = get_remainder(s);
+            bool c = is_continuation(s);
+
+            set_remainder(s, fr);
+            set_continuation(s, continuation);
+            set_shifted(s, shifted);
+            if (empty) {
+                break;
+            }
+
+            fr = r;
+            continuation = c;
+            shifted = true;
+            s = next(s);
+        }
+    }
+
+    bool remove_fingerprint(size_t f)
+    {
+        size_t fq = f >> remainder_bits_;
+        size_t fr = f & low_bits(remainder_bits_);
+        if (not is_occupied(fq)) {
+            return false;
+        }
+
+        size_t start = find_run_start(fq);
+        size_t s = start;
+        for (;;) {
+            size_t r = get_remainder(s);
+            if (r == fr) {
+                break;
+            }
+            s = next(s);
+            if (r > fr || not is_continuation(s)) {
+                return false;
+            }
+        }
+
+        bool head = s == start;
+        if (head && not is_continuation(next(s))) {
+            set_occupied(fq, false);
+        }
+        num_elems_ -= 1;
+
+        // Shift the rest of the cluster left by one slot. q tracks the
+        // quotient of the remainder being moved.
+        size_t q = fq;
+        size_t cur = s;
+        size_t nxt = next(s);
+        while (is_shifted(nxt)) {
+            bool continuation = is_continuation(nxt);
+            if (cur == s && head && continuation) {
+                // The successor becomes the new head of the run.
+                continuation = false;
+            } else if (not continuation) {
+                q = next_occupied(q);
+            }
+            set_remainder(cur, get_remainder(nxt));
+            set_continuation(cur, continuation);
+            set_shifted(cur, q != cur);
+            cur = nxt;
+            nxt = next(nxt);
+        }
+        set_remainder(cur, 0);
+        set_continuation(cur, false);
+        set_shifted(cur, false);
+        return true;
+    }
+
+    /**
+     * Call fn with every stored fingerprint by a linear scan of the table.
+     */
+    template<class F>
+    void for_each_fingerprint(F fn) const
+    {
+        if (num_elems_ == 0) {
+            return;
+        }
+        // Start from a slot that is empty or begins a cluster, so that the
+        // run heads met afterwards belong to the occupied slots in order.
+        size_t start = find_cluster_start(0);
+        size_t q = prev(start);
+        size_t i = start;
+        for (size_t n = 0; n < num_slots_; n++) {
+            if (not is_empty(i)) {
+                if (not is_continuation(i)) {
+                    q = next_occupied(q);
+                }
+                fn((q << remainder_bits_) | get_remainder(i));
+            }
+            i = next(i);
+        }
+    }
+
+    Hash hash_;
+
+    int quotient_bits_;
+
+    int remainder_bits_;
+
+    size_t num_slots_;
+
+    size_t num_elems_;
+
+    Block *blocks_;
+
+    BitTable<bits_per_key, kSlotsPerBlock> *table_;
+
+};
+
+#endif // COLOR4_QUOTIENT_FILTER_H
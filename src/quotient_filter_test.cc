@@ -0,0 +1,130 @@
+#include "quotient_filter.h"
+#include "gtest/gtest.h"
+#include "test_hash.h"
+#include <cstdint>
+
+class QuotientFilterTest : public ::testing::Test
+{
+
+public:
+    static size_t hash_c23(int x) {
+        return x * 23 * x * 123498711111;
+    }
+
+    static size_t hash_mix(int x) {
+        return splitmix64(x);
+    }
+
+    using Filter = QuotientFilter<12, int, size_t (*)(int)>;
+};
+
+TEST_F(QuotientFilterTest, OneElement)
+{
+    Filter filter(hash_c23, 100);
+    const int e1 = 9823147;
+    const int e2 = 4231678;
+    EXPECT_TRUE(filter.insert(e1));
+    EXPECT_TRUE(filter.query(e1));
+    EXPECT_FALSE(filter.query(e2));
+    EXPECT_TRUE(filter.remove(e1));
+    EXPECT_FALSE(filter.query(e1));
+    EXPECT_FALSE(filter.remove(e1));
+    EXPECT_EQ(0, filter.size());
+}
+
+TEST_F(QuotientFilterTest, Count)
+{
+    Filter filter(hash_mix, 100);
+    filter.insert(7);
+    filter.insert(7);
+    filter.insert(8);
+    EXPECT_EQ(2, filter.count(7));
+    EXPECT_EQ(1, filter.count(8));
+    EXPECT_TRUE(filter.remove(7));
+    EXPECT_EQ(1, filter.count(7));
+    EXPECT_TRUE(filter.query(7));
+}
+
+TEST_F(QuotientFilterTest, ManyElements)
+{
+    const int n = 3000;
+    Filter filter(hash_mix, n);
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(filter.insert(i));
+    }
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(filter.query(i)) << i;
+    }
+    size_t fp_count = 0;
+    for (int i = n; i < 2 * n; i++) {
+        fp_count += filter.query(i);
+    }
+    EXPECT_LT(fp_count, n / 100);
+
+    for (int i = 0; i < n; i += 2) {
+        ASSERT_TRUE(filter.remove(i)) << i;
+    }
+    for (int i = 1; i < n; i += 2) {
+        ASSERT_TRUE(filter.query(i)) << i;
+    }
+    EXPECT_EQ(n / 2, filter.size());
+}
+
+TEST_F(QuotientFilterTest, Full)
+{
+    Filter filter(hash_mix, 10);
+    size_t capacity = filter.capacity();
+    for (size_t i = 0; i < capacity; i++) {
+        ASSERT_TRUE(filter.insert(i));
+    }
+    EXPECT_FALSE(filter.insert(capacity));
+    for (size_t i = 0; i < capacity; i++) {
+        ASSERT_TRUE(filter.query(i)) << i;
+    }
+}
+
+TEST_F(QuotientFilterTest, Resize)
+{
+    Filter filter(hash_mix, 100);
+    const int n = filter.capacity();
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(filter.insert(i));
+    }
+    filter.resize();
+    EXPECT_EQ(11, filter.remainder_bits());
+    EXPECT_EQ(n, filter.size());
+    EXPECT_GE(filter.capacity(), 2 * n);
+    for (int i = n; i < 2 * n; i++) {
+        ASSERT_TRUE(filter.insert(i));
+    }
+    for (int i = 0; i < 2 * n; i++) {
+        ASSERT_TRUE(filter.query(i)) << i;
+    }
+}
+
+TEST_F(QuotientFilterTest, Merge)
+{
+    Filter a(hash_mix, 1000);
+    Filter b(hash_mix, 1000);
+    for (int i = 0; i < 900; i++) {
+        a.insert(i);
+        b.insert(i + 900);
+    }
+    b.resize();
+    a.merge(b);
+    EXPECT_EQ(1800, a.size());
+    // The same fingerprint length fits either remainder, so a keeps its own.
+    EXPECT_EQ(b.remainder_bits() + 1, a.remainder_bits());
+    for (int i = 0; i < 1800; i++) {
+        ASSERT_TRUE(a.query(i)) << i;
+    }
+
+    a.merge(a);
+    EXPECT_EQ(3600, a.size());
+    for (int i = 0; i < 1800; i++) {
+        ASSERT_GE(a.count(i), 2) << i;
+    }
+
+    Filter c(hash_mix, 100000);
+    EXPECT_THROW(a.merge(c), std::runtime_error);
+}
@@ -0,0 +1,168 @@
+#ifndef COLOR4_RANGE_FILTER_H
+#define COLOR4_RANGE_FILTER_H
+
+#include <cstdint>
+#include <stdint.h>
+#include <type_traits>
+#include <algorithm>
+
+#include "utils.h"
+#include "cuckoo_filter.h"
+
+/**
+ * A range filter over integer keys, built from a hierarchy of cuckoo filters
+ * over key prefixes (see: Luo et al., "Rosetta: A Robust Space-Time Optimized
+ * Range Filter for Key-Value Stores", SIGMOD 2020).
+ *
+ * Level l stores the prefixes key >> (l * level_bits), so a prefix at level l
+ * stands for an aligned block of 2^(l * level_bits) keys. A range query is
+ * split into the blocks of the highest useful level and walks down only
+ * through the blocks whose prefix is present, until it reaches a key at
+ * level 0. Empty ranges are usually rejected near the top with a few probes.
+ *
+ * Every level is sized for max_num_keys prefixes (or the number of blocks,
+ * if smaller), so the filter takes up to num_levels times the memory of a
+ * CuckooFilter. Keys can not be removed, since a prefix may be shared by
+ * several keys.
+ *
+ * @param num_levels The number of prefix levels. Level 0 holds the keys.
+ * @param level_bits The number of key bits dropped from one level to the next.
+ */
+template<int bits_per_key, class Key, class Hash, int num_levels = 8, int level_bits = 2,
+         int way = 4>
+class RangeFilter
+{
+public:
+    static_assert(std::is_same<Key, uint32_t>::value || std::is_same<Key, uint64_t>::value,
+            "RangeFilter only supports uint32_t and uint64_t");
+    static_assert(num_levels > 0 && level_bits > 0 &&
+            (num_levels - 1) * level_bits < (int) sizeof(Key) * kBitsPerByte,
+            "the prefix levels must fit in the key");
+
+    using Level = CuckooFilter<bits_per_key, Key, Hash, way>;
+
+    RangeFilter(Hash hash, size_t max_num_keys)
+    {
+        for (int l = 0; l < num_levels; l++) {
+            // A level can not hold more prefixes than there are blocks.
+            int bits = sizeof(Key) * kBitsPerByte - l * level_bits;
+            size_t num_keys = max_num_keys;
+            if (bits < 62) {
+                num_keys = std::min<size_t>(num_keys, (size_t) 2 << bits);
+            }
+            level_[l] = new Level(hash, num_keys);
+        }
+    }
+
+    ~RangeFilter()
+    {
+        for (int l = 0; l < num_levels; l++) {
+            delete level_[l];
+        }
+    }
+
+    RangeFilter(const RangeFilter &) = delete;
+    RangeFilter &operator=(const RangeFilter &) = delete;
+
+    /**
+     * Insert the prefixes from the top level down and the key last, so that
+     * every stored key has all of its prefixes.
+     * @return False if some level is full. The prefixes inserted so far are
+     * kept, which only adds false positives. As with CuckooFilter, the failed
+     * insertion may also drop a fingerprint it kicked out, so size the filter
+     * for the keys it is to hold.
+     */
+    bool insert(const Key &key)
+    {
+        for (int l = num_levels - 1; l > 0; l--) {
+            Key prefix = key >> (l * level_bits);
+            // Do not store a shared prefix again; it would only fill the
+            // buckets with copies.
+            if (level_[l]->query(prefix)) {
+                continue;
+            }
+            if (not level_[l]->insert(prefix)) {
+                return false;
+            }
+        }
+        return level_[0]->insert(key);
+    }
+
+    bool query(const Key &key)
+    {
+        return level_[0]->query(key);
+    }
+
+    /**
+     * Whether some key in [lo, hi] may have been inserted. It makes at most
+     * kMaxProbes filter lookups, and answers true when the range is too wide
+     * or the lookups run out.
+     */
+    bool may_contain_range(Key lo, Key hi)
+    {
+        if (lo > hi) {
+            return false;
+        }
+        // The lowest level at which the range spans at most two blocks.
+        // Above it, every block overlapping the range is an ancestor of these.
+        int top = 0;
+        while (top < num_levels - 1 &&
+                (hi >> (top * level_bits)) - (lo >> (top * level_bits)) > 1) {
+            top += 1;
+        }
+        Key first = lo >> (top * level_bits);
+        Key last = hi >> (top * level_bits);
+        if (last - first >= (Key) kMaxProbes) {
+            return true;
+        }
+        int budget = kMaxProbes;
+        for (Key p = first; ; p++) {
+            if (probe(top, p, lo, hi, &budget)) {
+                return true;
+            }
+            if (p == last) {
+                break;
+            }
+        }
+        return false;
+    }
+
+    static constexpr int kMaxProbes = 64;
+
+private:
+
+    /**
+     * Whether the block of prefix p at level l may hold a key in [lo, hi].
+     */
+    bool probe(int l, Key p, Key lo, Key hi, int *budget)
+    {
+        if (*budget == 0) {
+            return true;
+        }
+        *budget -= 1;
+        if (not level_[l]->query(p)) {
+            return false;
+        }
+        if (l == 0) {
+            return true;
+        }
+        int shift = (l - 1) * level_bits;
+        Key first = std::max<Key>(p << level_bits, lo >> shift);
+        Key last = std::min<Key>((p << level_bits) | kChildMask, hi >> shift);
+        for (Key c = first; ; c++) {
+            if (probe(l - 1, c, lo, hi, budget)) {
+                return true;
+            }
+            if (c == last) {
+                break;
+            }
+        }
+        return false;
+    }
+
+    static constexpr Key kChildMask = ((Key) 1 << level_bits) - 1;
+
+    Level *level_[num_levels];
+};
+
+#endif // COLOR4_RANGE_FILTER_H
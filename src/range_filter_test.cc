@@ -0,0 +1,64 @@
+#include "range_filter.h"
+#include "gtest/gtest.h"
+#include "test_hash.h"
+#include <cstdint>
+#include <set>
+#include <random>
+
+class RangeFilterTest : public ::testing::Test
+{
+
+public:
+    static size_t hash_mix(uint64_t x) {
+        return splitmix64(x);
+    }
+
+    static size_t hash_mix32(uint32_t x) {
+        return hash_mix(x);
+    }
+};
+
+TEST_F(RangeFilterTest, OneElement)
+{
+    RangeFilter<16, uint32_t, size_t (*)(uint32_t)> filter(hash_mix32, 100);
+    const uint32_t e1 = 9823147;
+    EXPECT_TRUE(filter.insert(e1));
+    EXPECT_TRUE(filter.query(e1));
+    EXPECT_FALSE(filter.query(e1 + 1));
+    EXPECT_TRUE(filter.may_contain_range(e1, e1));
+    EXPECT_TRUE(filter.may_contain_range(e1 - 10, e1 + 10));
+    EXPECT_TRUE(filter.may_contain_range(0, UINT32_MAX));
+    EXPECT_FALSE(filter.may_contain_range(e1 + 1, e1 + 100));
+    EXPECT_FALSE(filter.may_contain_range(e1 - 100, e1 - 1));
+    EXPECT_FALSE(filter.may_contain_range(e1 + 1, e1));
+}
+
+TEST_F(RangeFilterTest, NoFalseNegative)
+{
+    const int n = 1 << 12;
+    RangeFilter<12, uint64_t, size_t (*)(uint64_t)> filter(hash_mix, n);
+    std::mt19937_64 gen(20211124);
+    std::set<uint64_t> keys;
+    while (keys.size() < n * 0.9) {
+        uint64_t x = gen() >> 40;
+        keys.insert(x);
+        ASSERT_TRUE(filter.insert(x));
+    }
+
+    int num_empty = 0;
+    int num_false_positive = 0;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t lo = gen() >> 40;
+        uint64_t hi = lo + gen() % 1024;
+        bool contain = keys.lower_bound(lo) != keys.end() && *keys.lower_bound(lo) <= hi;
+        bool result = filter.may_contain_range(lo, hi);
+        if (contain) {
+            ASSERT_TRUE(result) << lo << " " << hi;
+        } else {
+            num_empty += 1;
+            num_false_positive += result;
+        }
+    }
+    EXPECT_GT(num_empty, 5000);
+    EXPECT_LT(num_false_positive, num_empty * 0.1);
+}
@@ -0,0 +1,384 @@
+#ifndef COLOR4_TABLE_CODEC_H
+#define COLOR4_TABLE_CODEC_H
+
+#include <cstdint>
+#include <istream>
+#include <math.h>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <algorithm>
+
+#include "utils.h"
+#include "bit_table.h"
+
+/**
+ * Write a stream of bit fields, least significant bit first.
+ */
+class BitWriter
+{
+public:
+    explicit BitWriter(std::ostream &out)
+        : out_(out), buf_(0), len_(0), bytes_(0)
+    {
+    }
+
+    /**
+     * Append the low nbits (<= 57) bits of value.
+     */
+    inline void put(uint64_t value, int nbits)
+    {
+        if (nbits == 0) {
+            return;
+        }
+        buf_ |= (value & ((1ull << nbits) - 1)) << len_;
+        len_ += nbits;
+        while (len_ >= kBitsPerByte) {
+            out_.put((char) (buf_ & 0xff));
+            buf_ >>= kBitsPerByte;
+            len_ -= kBitsPerByte;
+            bytes_ += 1;
+        }
+    }
+
+    inline void put64(uint64_t value)
+    {
+        put(value & 0xffffffff, 32);
+        put(value >> 32, 32);
+    }
+
+    /**
+     * Append q in unary: q one bits and a zero bit.
+     */
+    inline void put_unary(uint64_t q)
+    {
+        for (; q >= 32; q -= 32) {
+            put(0xffffffff, 32);
+        }
+        put((1ull << q) - 1, q + 1);
+    }
+
+    /**
+     * Pad the last byte with zero bits and write it.
+     */
+    void flush()
+    {
+        if (len_ > 0) {
+            out_.put((char) (buf_ & 0xff));
+            bytes_ += 1;
+        }
+        buf_ = 0;
+        len_ = 0;
+        out_.flush();
+    }
+
+    /// The number of bytes written so far.
+    inline size_t bytes() const
+    {
+        return bytes_;
+    }
+
+private:
+    std::ostream &out_;
+
+    uint64_t buf_;
+
+    int len_;
+
+    size_t bytes_;
+};
+
+/**
+ * Read the bit fields written by BitWriter.
+ */
+class BitReader
+{
+public:
+    explicit BitReader(std::istream &in)
+        : in_(in), buf_(0), len_(0)
+    {
+    }
+
+    /**
+     * Read nbits (<= 57) bits. Throws at the end of the stream.
+     */
+    inline uint64_t get(int nbits)
+    {
+        if (nbits == 0) {
+            return 0;
+        }
+        while (len_ < nbits) {
+            int c = in_.get();
+            if (c == std::char_traits<char>::eof()) {
+                throw std::runtime_error("TableCodec: truncated stream");
+            }
+            buf_ |= (uint64_t) (uint8_t) c << len_;
+            len_ += kBitsPerByte;
+        }
+        uint64_t value = buf_ & ((1ull << nbits) - 1);
+        buf_ >>= nbits;
+        len_ -= nbits;
+        return value;
+    }
+
+    inline uint64_t get64()
+    {
+        uint64_t lo = get(32);
+        return lo | (get(32) << 32);
+    }
+
+    inline uint64_t get_unary()
+    {
+        uint64_t q = 0;
+        while (get(1)) {
+            q += 1;
+        }
+        return q;
+    }
+
+private:
+    std::istream &in_;
+
+    uint64_t buf_;
+
+    int len_;
+};
+
+/**
+ * A compact, streaming transfer format for the contents of a BitTable, so
+ * that a filter built on one node can be shipped to others without
+ * re-inserting the keys.
+ *
+ * Header: magic, version, encoding, bits_per_elem, elems_per_bucket,
+ * num_buckets and the number of stored elements. The body is one of
+ *   kRaw:         every slot, empty or not. Decoding restores the exact table.
+ *   kBitmap:      per bucket, a bitmap of the non-empty slots followed by
+ *                 their elements. Decoding restores the exact table.
+ *   kSortedDelta: the non-empty slots as the sorted set of
+ *                 (bucket << bits_per_elem) | elem, with the gaps between
+ *                 consecutive values Golomb-Rice coded. This is smaller for
+ *                 lightly loaded tables, but decoding packs each bucket to
+ *                 its first slots in ascending order, so the slot positions
+ *                 (not the membership) may differ from the original.
+ * kAuto picks the smaller of the exact encodings, kRaw and kBitmap, for the
+ * number of stored elements, so an image is never larger than the raw table
+ * plus the header. kSortedDelta is only used when asked for; it suits
+ * membership filters, whose answers do not depend on the slot order.
+ */
+class TableCodec
+{
+public:
+    enum Encoding {
+        kBitmap = 0,
+        kSortedDelta = 1,
+        kRaw = 2,
+        /// Only for encode(): the smaller of kRaw and kBitmap.
+        kAuto = 3
+    };
+
+    template<int bits_per_elem, int elems_per_bucket, bool track_occupancy>
+    static size_t encode(const BitTable<bits_per_elem, elems_per_bucket, track_occupancy> &table,
+            std::ostream &out, Encoding encoding = kAuto)
+    {
+        static_assert(elems_per_bucket <= 57, "elems_per_bucket is too large");
+        size_t num_buckets = table.num_buckets();
+        uint64_t num_elems = 0;
+        for (size_t i = 0; i < num_buckets; i++) {
+            for (int j = 0; j < elems_per_bucket; j++) {
+                num_elems += table.get_elem(i, j) != 0;
+            }
+        }
+        if (encoding == kAuto) {
+            encoding = smallest_encoding(num_buckets, elems_per_bucket, bits_per_elem, num_elems);
+        }
+
+        BitWriter w(out);
+        w.put(kMagic, 32);
+        w.put(kVersion, 8);
+        w.put(encoding, 8);
+        w.put(bits_per_elem, 8);
+        w.put(elems_per_bucket, 8);
+        w.put64(num_buckets);
+        w.put64(num_elems);
+
+        if (encoding == kRaw) {
+            for (size_t i = 0; i < num_buckets; i++) {
+                for (int j = 0; j < elems_per_bucket; j++) {
+                    w.put(table.get_elem(i, j), bits_per_elem);
+                }
+            }
+        } else if (encoding == kBitmap) {
+            for (size_t i = 0; i < num_buckets; i++) {
+                uint64_t bitmap = 0;
+                for (int j = 0; j < elems_per_bucket; j++) {
+                    bitmap |= (uint64_t) (table.get_elem(i, j) != 0) << j;
+                }
+                w.put(bitmap, elems_per_bucket);
+                for (int j = 0; j < elems_per_bucket; j++) {
+                    if (bitmap & (1ull << j)) {
+                        w.put(table.get_elem(i, j), bits_per_elem);
+                    }
+                }
+            }
+        } else if (encoding == kSortedDelta) {
+            int k = rice_parameter(((uint64_t) num_buckets) << bits_per_elem, num_elems);
+            w.put(k, 8);
+            uint64_t prev = 0;
+            for (size_t i = 0; i < num_buckets; i++) {
+                uint32_t elem[elems_per_bucket];
+                int n = 0;
+                for (int j = 0; j < elems_per_bucket; j++) {
+                    uint32_t e = table.get_elem(i, j);
+                    if (e != 0) {
+                        elem[n++] = e;
+                    }
+                }
+                // Insertion sort: a bucket holds only a few elements.
+                for (int j = 1; j < n; j++) {
+                    uint32_t e = elem[j];
+                    int m = j;
+                    for (; m > 0 && elem[m - 1] > e; m--) {
+                        elem[m] = elem[m - 1];
+                    }
+                    elem[m] = e;
+                }
+                for (int j = 0; j < n; j++) {
+                    uint64_t value = ((uint64_t) i << bits_per_elem) | elem[j];
+                    uint64_t gap = value - prev;
+                    w.put_unary(gap >> k);
+                    w.put(gap, k);
+                    prev = value;
+                }
+            }
+        } else {
+            throw std::runtime_error("TableCodec: unknown encoding");
+        }
+        w.flush();
+        return w.bytes();
+    }
+
+    /**
+     * Overwrite table with an image written by encode(). The table must have
+     * the same layout and number of buckets.
+     */
+    template<int bits_per_elem, int elems_per_bucket, bool track_occupancy>
+    static void decode(std::istream &in,
+            BitTable<bits_per_elem, elems_per_bucket, track_occupancy> *table)
+    {
+        BitReader r(in);
+        if (r.get(32) != kMagic || r.get(8) != kVersion) {
+            throw std::runtime_error("TableCodec: not a table image");
+        }
+        uint64_t encoding = r.get(8);
+        if (r.get(8) != bits_per_elem || r.get(8) != elems_per_bucket) {
+            throw std::runtime_error("TableCodec: bucket layout mismatch");
+        }
+        size_t num_buckets = r.get64();
+        if (num_buckets != table->num_buckets()) {
+            throw std::runtime_error("TableCodec: number of buckets mismatch");
+        }
+        uint64_t num_elems = r.get64();
+
+        if (encoding == kRaw) {
+            uint64_t n = 0;
+            for (size_t i = 0; i < num_buckets; i++) {
+                for (int j = 0; j < elems_per_bucket; j++) {
+                    uint32_t e = r.get(bits_per_elem);
+                    n += e != 0;
+                    table->set_elem(i, j, e);
+                }
+            }
+            if (n != num_elems) {
+                throw std::runtime_error("TableCodec: corrupted table image");
+            }
+        } else if (encoding == kBitmap) {
+            uint64_t n = 0;
+            for (size_t i = 0; i < num_buckets; i++) {
+                uint64_t bitmap = r.get(elems_per_bucket);
+                for (int j = 0; j < elems_per_bucket; j++) {
+                    uint32_t e = 0;
+                    if (bitmap & (1ull << j)) {
+                        e = r.get(bits_per_elem);
+                        // An element of 0 would be an empty slot.
+                        if (e == 0) {
+                            throw std::runtime_error("TableCodec: corrupted table image");
+                        }
+                        n += 1;
+                    }
+                    table->set_elem(i, j, e);
+                }
+            }
+            if (n != num_elems) {
+                throw std::runtime_error("TableCodec: corrupted table image");
+            }
+        } else if (encoding == kSortedDelta) {
+            int k = r.get(8);
+            // See rice_parameter.
+            if (k > 56) {
+                throw std::runtime_error("TableCodec: corrupted table image");
+            }
+            uint64_t value = 0;
+            size_t bucket = 0;
+            int slot = 0;
+            for (uint64_t n = 0; n < num_elems; n++) {
+                value += (r.get_unary() << k) | r.get(k);
+                size_t i = value >> bits_per_elem;
+                uint32_t e = value & ((1ull << bits_per_elem) - 1);
+                // An element of 0 would be an empty slot.
+                if (i >= num_buckets || e == 0 ||
+                        (i == bucket && slot == elems_per_bucket)) {
+                    throw std::runtime_error("TableCodec: corrupted table image");
+                }
+                for (; bucket < i; bucket++, slot = 0) {
+                    for (; slot < elems_per_bucket; slot++) {
+                        table->set_elem(bucket, slot, 0);
+                    }
+                }
+                table->set_elem(bucket, slot++, e);
+            }
+            for (; bucket < num_buckets; bucket++, slot = 0) {
+                for (; slot < elems_per_bucket; slot++) {
+                    table->set_elem(bucket, slot, 0);
+                }
+            }
+        } else {
+            throw std::runtime_error("TableCodec: unknown encoding");
+        }
+    }
+
+private:
+    static constexpr uint32_t kMagic = 0x42543443;  // "C4TB"
+
+    static constexpr uint32_t kVersion = 1;
+
+    /**
+     * The exact encoding with the smaller body for num_elems stored elements.
+     */
+    static Encoding smallest_encoding(size_t num_buckets, int elems_per_bucket,
+            int bits_per_elem, uint64_t num_elems)
+    {
+        uint64_t num_slots = (uint64_t) num_buckets * elems_per_bucket;
+        uint64_t raw = num_slots * bits_per_elem;
+        uint64_t bitmap = num_slots + num_elems * bits_per_elem;
+        if (bitmap < raw) {
+            return kBitmap;
+        }
+        return kRaw;
+    }
+
+    /**
+     * The Golomb-Rice parameter for n values spread over [0, universe):
+     * about log2 of the mean gap times ln(2).
+     */
+    static int rice_parameter(uint64_t universe, uint64_t n)
+    {
+        if (n == 0) {
+            return 0;
+        }
+        double mean_gap = (double) universe / n;
+        int k = (int) floor(log2(std::max(1.0, mean_gap * log(2.0))));
+        return std::min(std::max(k, 0), 56);
+    }
+};
+
+#endif // COLOR4_TABLE_CODEC_H
@@ -0,0 +1,244 @@
+#include "table_codec.h"
+#include "color_filter.h"
+#include "cuckoo_filter.h"
+#include "gtest/gtest.h"
+#include "test_hash.h"
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+class TableCodecTest : public ::testing::Test
+{
+
+public:
+    static size_t hash_mix(int x) {
+        return splitmix64(x);
+    }
+
+    /**
+     * Fill a fraction of the slots with random elements.
+     */
+    template<int bits, int way>
+    static void fill(BitTable<bits, way> *table, double load)
+    {
+        std::mt19937 gen(1);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        for (size_t i = 0; i < table->num_buckets(); i++) {
+            for (int j = 0; j < way; j++) {
+                if (uniform(gen) < load) {
+                    table->set_elem(i, j, gen() | 1);
+                }
+            }
+        }
+    }
+};
+
+TEST_F(TableCodecTest, Bitmap)
+{
+    BitTable<12, 4> table(1000);
+    fill(&table, 0.3);
+    std::stringstream ss;
+    size_t bytes = TableCodec::encode(table, ss, TableCodec::kBitmap);
+    EXPECT_EQ(bytes, ss.str().size());
+    EXPECT_LT(bytes, 1000 * 6 / 2);
+
+    BitTable<12, 4> copy(1000);
+    copy.set_elem(3, 3, 7);
+    TableCodec::decode(ss, &copy);
+    for (size_t i = 0; i < 1000; i++) {
+        for (int j = 0; j < 4; j++) {
+            ASSERT_EQ(table.get_elem(i, j), copy.get_elem(i, j));
+        }
+    }
+}
+
+TEST_F(TableCodecTest, SortedDelta)
+{
+    BitTable<16, 4> table(1000);
+    fill(&table, 0.3);
+    std::stringstream bitmap;
+    std::stringstream delta;
+    TableCodec::encode(table, bitmap, TableCodec::kBitmap);
+    TableCodec::encode(table, delta, TableCodec::kSortedDelta);
+    EXPECT_LT(delta.str().size(), bitmap.str().size());
+
+    BitTable<16, 4> copy(1000);
+    copy.set_elem(999, 3, 7);
+    TableCodec::decode(delta, &copy);
+    // Each bucket holds the same elements, packed in ascending order.
+    for (size_t i = 0; i < 1000; i++) {
+        std::vector<uint32_t> expected;
+        for (int j = 0; j < 4; j++) {
+            if (table.get_elem(i, j) != 0) {
+                expected.push_back(table.get_elem(i, j));
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.resize(4, 0);
+        for (int j = 0; j < 4; j++) {
+            ASSERT_EQ(expected[j], copy.get_elem(i, j));
+        }
+    }
+}
+
+TEST_F(TableCodecTest, Auto)
+{
+    // 24 bytes of header, and 1000 buckets of 6 bytes in the raw table.
+    const size_t raw = 24 + 1000 * 6;
+    for (double load : {0.01, 0.3, 0.6, 0.95, 1.0}) {
+        BitTable<12, 4> table(1000);
+        fill(&table, load);
+        std::stringstream ss;
+        size_t bytes = TableCodec::encode(table, ss);
+        EXPECT_LE(bytes, raw) << load;
+        std::stringstream bitmap;
+        EXPECT_LE(bytes, TableCodec::encode(table, bitmap, TableCodec::kBitmap)) << load;
+
+        // Only the exact encodings are chosen.
+        BitTable<12, 4> copy(1000);
+        TableCodec::decode(ss, &copy);
+        for (size_t i = 0; i < 1000; i++) {
+            for (int j = 0; j < 4; j++) {
+                ASSERT_EQ(table.get_elem(i, j), copy.get_elem(i, j)) << load;
+            }
+        }
+    }
+}
+
+TEST_F(TableCodecTest, Raw)
+{
+    BitTable<12, 4> table(1000);
+    fill(&table, 0.95);
+    std::stringstream ss;
+    EXPECT_EQ(24 + 1000 * 6, TableCodec::encode(table, ss, TableCodec::kRaw));
+
+    BitTable<12, 4> copy(1000);
+    TableCodec::decode(ss, &copy);
+    for (size_t i = 0; i < 1000; i++) {
+        for (int j = 0; j < 4; j++) {
+            ASSERT_EQ(table.get_elem(i, j), copy.get_elem(i, j));
+        }
+    }
+}
+
+TEST_F(TableCodecTest, ZeroElement)
+{
+    // A kSortedDelta image of one element 0 in bucket 1.
+    std::stringstream ss;
+    BitWriter w(ss);
+    w.put(0x42543443, 32);
+    w.put(1, 8);
+    w.put(TableCodec::kSortedDelta, 8);
+    w.put(12, 8);
+    w.put(4, 8);
+    w.put64(16);
+    w.put64(1);
+    w.put(0, 8);
+    w.put_unary(1 << 12);
+    w.flush();
+
+    BitTable<12, 4> table(16);
+    EXPECT_THROW(TableCodec::decode(ss, &table), std::runtime_error);
+}
+
+TEST_F(TableCodecTest, Corrupted)
+{
+    // A kSortedDelta image with a Rice parameter out of range.
+    {
+        std::stringstream ss;
+        BitWriter w(ss);
+        w.put(0x42543443, 32);
+        w.put(1, 8);
+        w.put(TableCodec::kSortedDelta, 8);
+        w.put(12, 8);
+        w.put(4, 8);
+        w.put64(16);
+        w.put64(1);
+        w.put(60, 8);
+        w.put64(~0ull);
+        w.put64(~0ull);
+        w.flush();
+
+        BitTable<12, 4> table(16);
+        EXPECT_THROW(TableCodec::decode(ss, &table), std::runtime_error);
+    }
+
+    // A kBitmap image with fewer elements than its header says.
+    {
+        BitTable<12, 4> table(16);
+        table.set_elem(3, 1, 5);
+        std::stringstream ss;
+        TableCodec::encode(table, ss, TableCodec::kBitmap);
+        std::string image = ss.str();
+        // The element count is a little-endian uint64_t at byte 16.
+        image[16] = 2;
+        std::stringstream corrupted(image);
+        EXPECT_THROW(TableCodec::decode(corrupted, &table), std::runtime_error);
+    }
+}
+
+TEST_F(TableCodecTest, ColorFilter)
+{
+    // Colliding keys must read the same colors after a transfer, so the
+    // slot order of each bucket has to be kept.
+    using Filter = ColorFilter<8, 4, int, size_t (*)(int)>;
+    Filter builder(hash_mix, 1 << 16);
+    for (int i = 0; i < 20000; i++) {
+        builder.insert(i, i % 16);
+    }
+    std::stringstream ss;
+    builder.export_table(ss);
+    std::stringstream delta;
+    EXPECT_THROW(builder.export_table(delta, TableCodec::kSortedDelta), std::runtime_error);
+
+    Filter replica(hash_mix, 1 << 16);
+    replica.import_table(ss);
+    for (int i = 0; i < 40000; i++) {
+        uint32_t expected = 0;
+        uint32_t value = 0;
+        bool found = builder.lookup(i, &expected);
+        ASSERT_EQ(found, replica.lookup(i, &value)) << i;
+        if (found) {
+            ASSERT_EQ(expected, value) << i;
+        }
+    }
+}
+
+TEST_F(TableCodecTest, Mismatch)
+{
+    BitTable<12, 4> table(16);
+    std::stringstream ss;
+    TableCodec::encode(table, ss);
+    BitTable<12, 4> other(32);
+    EXPECT_THROW(TableCodec::decode(ss, &other), std::runtime_error);
+
+    std::stringstream garbage("not a table");
+    EXPECT_THROW(TableCodec::decode(garbage, &table), std::runtime_error);
+
+    std::string image;
+    {
+        std::stringstream full;
+        TableCodec::encode(table, full);
+        image = full.str();
+    }
+    std::stringstream truncated(image.substr(0, image.size() - 1));
+    EXPECT_THROW(TableCodec::decode(truncated, &table), std::runtime_error);
+}
+
+TEST_F(TableCodecTest, Filter)
+{
+    CuckooFilter<12, int, size_t (*)(int)> builder(hash_mix, 4096);
+    for (int i = 0; i < 1000; i++) {
+        builder.insert(i);
+    }
+    std::stringstream ss;
+    builder.export_table(ss);
+
+    CuckooFilter<12, int, size_t (*)(int)> replica(hash_mix, 4096);
+    replica.import_table(ss);
+    for (int i = 0; i < 2000; i++) {
+        ASSERT_EQ(builder.query(i), replica.query(i)) << i;
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef COLOR4_TEST_HASH_H
+#define COLOR4_TEST_HASH_H
+
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * A well-mixed hash for the tests: the splitmix64 finalizer.
+ */
+inline size_t splitmix64(uint64_t x)
+{
+    uint64_t z = x + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+#endif // COLOR4_TEST_HASH_H
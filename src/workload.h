@@ -0,0 +1,372 @@
+#ifndef COLOR4_WORKLOAD_H
+#define COLOR4_WORKLOAD_H
+
+#include <cstdint>
+#include <math.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cassert>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "city.h"
+#include "utils.h"
+
+/**
+ * A seeded bijection on Key. Mapping the indices 0, 1, 2, ... through it
+ * yields unique pseudo-random keys without remembering the keys generated so
+ * far, and any key of index >= n is known not to be among the first n keys.
+ * The index must fit in Key, i.e. be below 2^32 for uint32_t keys; larger
+ * indices would repeat earlier keys.
+ */
+template<class Key>
+class KeyPermutation
+{
+public:
+    static_assert(std::is_same<Key, uint32_t>::value || std::is_same<Key, uint64_t>::value,
+            "KeyPermutation only supports uint32_t and uint64_t");
+
+    explicit KeyPermutation(uint64_t seed)
+        : seed_(seed)
+    {
+    }
+
+    inline Key operator()(uint64_t index) const
+    {
+        assert(index == (Key) index && "KeyPermutation: index does not fit in Key");
+        return permute((Key) index);
+    }
+
+private:
+
+    // Every step is invertible: xor with a constant, xorshift, and
+    // multiplication by an odd constant.
+    inline uint32_t permute(uint32_t x) const
+    {
+        // lowbias32, see: https://nullprogram.com/blog/2018/07/31/
+        x ^= (uint32_t) seed_;
+        x ^= x >> 16;
+        x *= 0x7feb352d;
+        x ^= x >> 15;
+        x *= 0x846ca68b;
+        x ^= x >> 16;
+        return x;
+    }
+
+    inline uint64_t permute(uint64_t x) const
+    {
+        // splitmix64 finalizer
+        x ^= seed_;
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111eb;
+        x ^= x >> 31;
+        return x;
+    }
+
+    uint64_t seed_;
+};
+
+/**
+ * Run fn(begin, end) over [0, n) split into contiguous ranges, one per thread.
+ * @param num_threads 0 means one thread per hardware thread.
+ * @param grain       The minimum number of items worth a thread.
+ */
+template<class F>
+void parallel_for(size_t n, F fn, unsigned num_threads = 0, size_t grain = 1 << 16)
+{
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    num_threads = std::max<size_t>(1, std::min<size_t>(num_threads, n / grain));
+    if (num_threads == 1) {
+        fn((size_t) 0, n);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    size_t chunk = (n + num_threads - 1) / num_threads;
+    for (size_t begin = 0; begin < n; begin += chunk) {
+        size_t end = std::min(n, begin + chunk);
+        threads.emplace_back([=]() { fn(begin, end); });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+/**
+ * out[i] = perm(first + i) for i in [0, n), computed in parallel.
+ */
+template<class Key>
+void generate_keys(Key *out, uint64_t first, size_t n, const KeyPermutation<Key> &perm,
+        unsigned num_threads = 0)
+{
+    parallel_for(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            out[i] = perm(first + i);
+        }
+    }, num_threads);
+}
+
+/**
+ * Zipf distribution over the ranks [0, n): rank k is drawn with probability
+ * proportional to 1 / (k + 1)^s. s = 0 is the uniform distribution.
+ * It uses rejection-inversion sampling, which needs O(1) time and memory.
+ * See: Hormann and Derflinger, "Rejection-inversion to generate variates
+ * from monotone discrete distributions", 1996.
+ */
+class ZipfDistribution
+{
+public:
+    ZipfDistribution(uint64_t n, double s)
+        : n_(n), s_(s)
+    {
+        if (n == 0 || s < 0) {
+            throw std::invalid_argument("ZipfDistribution: n must be positive and s non-negative");
+        }
+        h_integral_x1_ = h_integral(1.5) - 1;
+        h_integral_n_ = h_integral(n_ + 0.5);
+        threshold_ = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+    }
+
+    template<class URNG>
+    uint64_t operator()(URNG &gen) const
+    {
+        std::uniform_real_distribution<double> uniform(0, 1);
+        if (s_ == 0) {
+            return std::min<uint64_t>(n_ - 1, (uint64_t) (uniform(gen) * n_));
+        }
+        for (;;) {
+            double u = h_integral_n_ + uniform(gen) * (h_integral_x1_ - h_integral_n_);
+            double x = h_integral_inverse(u);
+            double k = floor(x + 0.5);
+            if (k < 1) {
+                k = 1;
+            } else if (k > n_) {
+                k = n_;
+            }
+            if (k - x <= threshold_ || u >= h_integral(k + 0.5) - h(k)) {
+                return (uint64_t) k - 1;
+            }
+        }
+    }
+
+private:
+
+    inline double h(double x) const
+    {
+        return exp(-s_ * log(x));
+    }
+
+    // The integral of h, i.e. ((x^(1 - s)) - 1) / (1 - s), stable around s = 1.
+    inline double h_integral(double x) const
+    {
+        double log_x = log(x);
+        return helper2((1 - s_) * log_x) * log_x;
+    }
+
+    inline double h_integral_inverse(double x) const
+    {
+        double t = x * (1 - s_);
+        if (t < -1) {
+            t = -1;
+        }
+        return exp(helper1(t) * x);
+    }
+
+    // log(1 + x) / x
+    static inline double helper1(double x)
+    {
+        if (fabs(x) > 1e-8) {
+            return log1p(x) / x;
+        }
+        return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+
+    // (exp(x) - 1) / x
+    static inline double helper2(double x)
+    {
+        if (fabs(x) > 1e-8) {
+            return expm1(x) / x;
+        }
+        return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+    }
+
+    uint64_t n_;
+
+    double s_;
+
+    double h_integral_x1_;
+
+    double h_integral_n_;
+
+    double threshold_;
+};
+
+/**
+ * A read-only memory mapping of a whole file.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const char *path)
+        : data_(nullptr), size_(0)
+    {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("cannot open ") + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            throw std::runtime_error(std::string("cannot stat ") + path);
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error(std::string("cannot mmap ") + path);
+            }
+            // The trace is read front to back.
+            madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = (const char *) p;
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data_) {
+            munmap((void *) data_, size_);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    inline const char *data() const
+    {
+        return data_;
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    const char *data_;
+
+    size_t size_;
+};
+
+/**
+ * A sequence of 64-bit keys read from a trace file.
+ *
+ * Binary traces are arrays of little-endian uint32_t or uint64_t and are read
+ * in place from the mapping. Text traces hold one key per line; a line that
+ * is a decimal number is that number, any other line is hashed to 64 bits.
+ * Text traces are streamed through the mapping once to build the key array.
+ */
+class KeyTrace
+{
+public:
+    enum Format {
+        kBinary32,
+        kBinary64,
+        kText
+    };
+
+    KeyTrace(const char *path, Format format)
+        : file_(path), format_(format)
+    {
+        if (format_ == kBinary32) {
+            size_ = file_.size() / sizeof(uint32_t);
+        } else if (format_ == kBinary64) {
+            size_ = file_.size() / sizeof(uint64_t);
+        } else {
+            parse_text();
+            size_ = text_keys_.size();
+        }
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    inline uint64_t operator[](size_t i) const
+    {
+        if (format_ == kBinary32) {
+            uint32_t x;
+            memcpy(&x, file_.data() + i * sizeof(x), sizeof(x));
+            return x;
+        } else if (format_ == kBinary64) {
+            uint64_t x;
+            memcpy(&x, file_.data() + i * sizeof(x), sizeof(x));
+            return x;
+        }
+        return text_keys_[i];
+    }
+
+private:
+
+    void parse_text()
+    {
+        const char *p = file_.data();
+        const char *end = p + file_.size();
+        while (p < end) {
+            const char *eol = (const char *) memchr(p, '\n', end - p);
+            if (eol == nullptr) {
+                eol = end;
+            }
+            const char *line_end = eol;
+            if (line_end > p && line_end[-1] == '\r') {
+                line_end--;
+            }
+            if (line_end > p) {
+                text_keys_.push_back(parse_key(p, line_end));
+            }
+            p = eol + 1;
+        }
+    }
+
+    static uint64_t parse_key(const char *begin, const char *end)
+    {
+        uint64_t x = 0;
+        const char *p = begin;
+        // At most 19 digits so that the value cannot overflow.
+        while (p < end && p - begin < 19 && *p >= '0' && *p <= '9') {
+            x = x * 10 + (*p - '0');
+            p++;
+        }
+        if (p == end) {
+            return x;
+        }
+        return CityHash64(begin, end - begin);
+    }
+
+    MappedFile file_;
+
+    Format format_;
+
+    size_t size_;
+
+    std::vector<uint64_t> text_keys_;
+};
+
+#endif // COLOR4_WORKLOAD_H
@@ -0,0 +1,60 @@
+#include "workload.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+TEST(WorkloadTest, PermutationIsDistinct)
+{
+    const size_t n = 1 << 18;
+    KeyPermutation<uint32_t> perm(20211124);
+    std::vector<uint32_t> keys(n);
+    generate_keys(keys.data(), 0, n, perm, 4);
+    for (size_t i = 0; i < n; i += 1013) {
+        EXPECT_EQ(perm(i), keys[i]);
+    }
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(keys.end(), std::adjacent_find(keys.begin(), keys.end()));
+
+    KeyPermutation<uint64_t> perm64(1);
+    EXPECT_NE(perm64(0), perm64(1));
+}
+
+TEST(WorkloadTest, Zipf)
+{
+    std::mt19937_64 gen(1);
+    ZipfDistribution uniform(10, 0);
+    ZipfDistribution zipf(1000, 1.2);
+    size_t count[1000] = {0};
+    for (int i = 0; i < 100000; i++) {
+        EXPECT_LT(uniform(gen), 10);
+        uint64_t k = zipf(gen);
+        ASSERT_LT(k, 1000);
+        count[k] += 1;
+    }
+    EXPECT_GT(count[0], count[1]);
+    EXPECT_GT(count[1], count[10]);
+    EXPECT_GT(count[10], count[999]);
+}
+
+TEST(WorkloadTest, TextTrace)
+{
+    char path[] = "/tmp/color4_trace_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    const char text[] = "12\r\nfoo\n\n34";
+    ASSERT_EQ(sizeof(text) - 1, write(fd, text, sizeof(text) - 1));
+    close(fd);
+
+    KeyTrace trace(path, KeyTrace::kText);
+    ASSERT_EQ(3, trace.size());
+    EXPECT_EQ(12, trace[0]);
+    EXPECT_EQ(CityHash64("foo", 3), trace[1]);
+    EXPECT_EQ(34, trace[2]);
+
+    KeyTrace binary(path, KeyTrace::kBinary32);
+    EXPECT_EQ(2, binary.size());
+    unlink(path);
+}
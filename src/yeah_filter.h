@@ -9,23 +9,39 @@
 #include <stdint.h>
 #include <type_traits>
 #include <algorithm>
+#include <istream>
+#include <ostream>
 
 #include "utils.h"
 #include "bit_table.h"
+#include "table_codec.h"
 #include "city.h"
 
-template<int bits_per_key, class Key, class Hash, int way = 4>
+/**
+ * A cuckoo filter whose candidate buckets form a dim-dimensional XOR vector
+ * space (see docs/docs.tex). Each dimension d has its own fingerprint hash
+ * offset_d(fp), and a key may live in any bucket h ^ (XOR of a subset of the
+ * offsets), i.e. in one of 2^dim buckets. dim = 1 is the classic cuckoo
+ * filter; dim = 2 is the original YeahFilter with four candidate buckets.
+ *
+ * @param dim The dimension of the bucket space.
+ * @param track_occupancy Keep per-bucket occupancy bitmaps in the table, and
+ *        insert into the least loaded candidate bucket.
+ */
+template<int bits_per_key, class Key, class Hash, int way = 4, int dim = 2,
+         bool track_occupancy = false>
 class YeahFilter 
 {
 public:
     static_assert(std::is_same<size_t, decltype(std::declval<Hash>()(std::declval<Key>()))>::value, 
             "The hash function needs to return size_t");
+    static_assert(dim >= 1 && dim <= 8, "dim must be in [1, 8]");
 
     YeahFilter(Hash hash, size_t max_num_keys)
         : hash_(hash)
     {
         num_buckets_ = upperpower2(std::max<size_t>(1, max_num_keys / way));
-        table_ = new BitTable<bits_per_key, way>(num_buckets_);
+        table_ = new BitTable<bits_per_key, way, track_occupancy>(num_buckets_);
     }
 
     ~YeahFilter() 
@@ -39,22 +55,34 @@ public:
         size_t fp;
         generate_hash(v, &h, &fp);
         for (int i = 0; i < kMaxKick; i++) {
-            bool kick = i > 3;
-            uint32_t last;
-
-            if (table_->insert_elem(h, fp, kick, &last)) {
-                return true;
-            }
-
-            if (kick) {
-                fp = last;
-            }
-
-            if (i & 1) {
-                h = xor_hash_fp1(h, fp);
+            size_t bucket[kNumCandidates];
+            candidate_buckets(h, fp, bucket);
+
+            uint32_t last = 0;
+            // After a kick, bucket[0] is the bucket we have just filled.
+            if (track_occupancy) {
+                int best = i > 0;
+                for (int j = best + 1; j < kNumCandidates; j++) {
+                    if (table_->load(bucket[j]) < table_->load(bucket[best])) {
+                        best = j;
+                    }
+                }
+                if (table_->insert_elem(bucket[best], fp, false, &last)) {
+                    return true;
+                }
             } else {
-                h = xor_hash_fp2(h, fp);
+                for (int j = i > 0; j < kNumCandidates; j++) {
+                    if (table_->insert_elem(bucket[j], fp, false, &last)) {
+                        return true;
+                    }
+                }
             }
+
+            // All candidates are full. Kick a victim out of one of the
+            // alternate buckets, rotating so that we do not bounce between two.
+            h = bucket[1 + i % (kNumCandidates - 1)];
+            table_->insert_elem(h, fp, true, &last);
+            fp = last;
         }
 	return false;
     }
@@ -65,42 +93,49 @@ public:
         size_t fp;
         generate_hash(v, &h, &fp);
 
-        if (table_->query_elem(h, fp)) {
-            return true;
-        }
-        size_t h2 = xor_hash_fp2(h, fp);
-        if (table_->query_elem(h2, fp)) {
-            return true;
-        }
-        size_t h3 = xor_hash_fp1(h2, fp);
-        if (table_->query_elem(h3, fp)) {
-            return true;
-        }
-        size_t h4 = xor_hash_fp1(h, fp);
-        if (table_->query_elem(h4, fp)) {
-            return true;
+        size_t bucket[kNumCandidates];
+        candidate_buckets(h, fp, bucket);
+        for (int j = 0; j < kNumCandidates; j++) {
+            if (table_->query_elem(bucket[j], fp)) {
+                return true;
+            }
         }
-        
         return false;
     }
 
-    /*
     void remove(const Key &v) 
     {
-        size_t h1;
+        size_t h;
         size_t fp;
-        generate_hash(v, &h1, &fp);
+        generate_hash(v, &h, &fp);
 
-        if (table_->delete_elem(h1, fp)) {
-            return;
+        size_t bucket[kNumCandidates];
+        candidate_buckets(h, fp, bucket);
+        for (int j = 0; j < kNumCandidates; j++) {
+            if (table_->delete_elem(bucket[j], fp)) {
+                return;
+            }
         }
+    }
 
-        size_t h2 = xor_hash_fp2(h1, fp);
-        if (table_->delete_elem(h2, fp)) {
-            return;
-        }
+    /**
+     * Write the table in the compact transfer format of TableCodec.
+     * @return The number of bytes written.
+     */
+    size_t export_table(std::ostream &out,
+            TableCodec::Encoding encoding = TableCodec::kAuto) const
+    {
+        return TableCodec::encode(*table_, out, encoding);
+    }
+
+    /**
+     * Replace the table with an image from export_table() of a filter that
+     * has the same hash function and max_num_keys.
+     */
+    void import_table(std::istream &in)
+    {
+        TableCodec::decode(in, table_);
     }
-    */
 
 private:
 
@@ -128,17 +163,40 @@ private:
         // log_debug("%s(%u) -> %zu %zu\n", __FUNCTION__, key, *h1, *fp);
     }
 
-    inline size_t xor_hash_fp1(size_t h, size_t fp)
+    static constexpr int kNumCandidates = 1 << dim;
+
+    /**
+     * The offset of dimension d. Dimension 0 uses the offset of CuckooFilter
+     * so that dim = 1 behaves like it.
+     */
+    inline size_t fp_hash(int d, size_t fp) const
     {
-        size_t h1 = (h ^ ((uint32_t) fp * 0x5bd1e995));
-        return h1 & (num_buckets_ - 1);
+        if (d == 0) {
+            return (uint32_t) fp * 0x5bd1e995;
+        } else if (d == 1) {
+            return (uint32_t) CityHash64((const char*) &fp, sizeof(fp));
+        } else {
+            return (uint32_t) CityHash64WithSeed((const char*) &fp, sizeof(fp), d);
+        }
     }
 
-    inline size_t xor_hash_fp2(size_t h, size_t fp)
+    /**
+     * Compute all candidate buckets of (h, fp) and prefetch them. They are
+     * enumerated in Gray code order starting from h, so that each one is its
+     * predecessor XOR a single offset.
+     */
+    inline void candidate_buckets(size_t h, size_t fp, size_t *bucket)
     {
-        size_t hash_fp = CityHash64((const char*) &fp, sizeof(fp));
-        size_t h1 = (h ^ ((uint32_t) hash_fp));
-        return h1 & (num_buckets_ - 1);
+        size_t offset[dim];
+        for (int d = 0; d < dim; d++) {
+            offset[d] = fp_hash(d, fp);
+        }
+        bucket[0] = h;
+        table_->prefetch(h);
+        for (int j = 1; j < kNumCandidates; j++) {
+            bucket[j] = (bucket[j - 1] ^ offset[__builtin_ctz(j)]) & (num_buckets_ - 1);
+            table_->prefetch(bucket[j]);
+        }
     }
 
     Hash hash_;
@@ -147,7 +205,7 @@ private:
 
     static constexpr int kMaxKick = 500;
 
-    BitTable<bits_per_key, way> *table_;
+    BitTable<bits_per_key, way, track_occupancy> *table_;
 
 };
 
@@ -0,0 +1,89 @@
+#include "yeah_filter.h"
+#include "gtest/gtest.h"
+#include "test_hash.h"
+#include <cstdint>
+
+class YeahFilterTest : public ::testing::Test
+{
+
+public:
+    static size_t hash_c23(int x) {
+        return x * 23 * x * 123498711111;
+    }
+
+    static size_t hash_mix(int x) {
+        return splitmix64(x);
+    }
+
+    /**
+     * Insert keys into a filter of 4096 slots until an insertion fails.
+     * @return The number of inserted keys.
+     */
+    template<int dim, bool track_occupancy = false>
+    static int fill()
+    {
+        const int n = 4096;
+        YeahFilter<12, int, size_t (*)(int), 4, dim, track_occupancy> filter(hash_mix, n);
+        int inserted = 0;
+        while (inserted < n && filter.insert(inserted)) {
+            inserted += 1;
+        }
+        return inserted;
+    }
+
+    /**
+     * Insert keys up to a load factor of 0.9 and check for false negatives.
+     */
+    template<int dim, bool track_occupancy = false>
+    static void no_false_negative()
+    {
+        const int n = 4096;
+        YeahFilter<12, int, size_t (*)(int), 4, dim, track_occupancy> filter(hash_mix, n);
+        for (int i = 0; i < n * 0.9; i++) {
+            ASSERT_TRUE(filter.insert(i)) << i;
+        }
+        for (int i = 0; i < n * 0.9; i += 2) {
+            filter.remove(i);
+        }
+        for (int i = 1; i < n * 0.9; i += 2) {
+            ASSERT_TRUE(filter.query(i)) << i;
+        }
+    }
+};
+
+TEST_F(YeahFilterTest, OneElement)
+{
+    YeahFilter<12, int, size_t (*)(int)> filter(hash_c23, 100);
+    const int e1 = 9823147;
+    const int e2 = 4231678;
+    filter.insert(e1);
+    EXPECT_TRUE(filter.query(e1));
+    EXPECT_FALSE(filter.query(e2));
+    filter.remove(e1);
+    EXPECT_FALSE(filter.query(e1));
+    EXPECT_FALSE(filter.query(e2));
+}
+
+TEST_F(YeahFilterTest, NoFalseNegative)
+{
+    no_false_negative<1>();
+    no_false_negative<2>();
+    no_false_negative<3>();
+}
+
+TEST_F(YeahFilterTest, LoadFactor)
+{
+    int load1 = fill<1>();
+    int load2 = fill<2>();
+    int load3 = fill<3>();
+    EXPECT_GT(load1, 4096 * 0.9);
+    EXPECT_GE(load2, load1);
+    EXPECT_GE(load3, load2);
+}
+
+TEST_F(YeahFilterTest, TrackOccupancy)
+{
+    no_false_negative<2, true>();
+    int load = fill<2, true>();
+    EXPECT_GT(load, 4096 * 0.9);
+}
@@ -0,0 +1,394 @@
+// Replay a key trace, or a synthetic workload, against a filter.
+//
+// The workload has two phases. The load phase inserts the first
+// --load fraction of the keys. The run phase then issues --ops operations
+// drawn from the --mix of inserts, queries and deletes:
+//   - queries target loaded keys, in trace order, or following a Zipf
+//     distribution over the key ranks when --skew is positive; a query may
+//     ask for a key that has been deleted earlier in the run;
+//   - deletes remove distinct loaded keys in a random order, so that no key
+//     is deleted twice;
+//   - inserts take the keys after the loaded ones, in trace order; a trace
+//     must have enough unloaded keys for them;
+//   - with --negative, that fraction of the queries asks for keys that are
+//     known not to be in the filter (synthetic keys only), which measures the
+//     false positive rate.
+// Synthetic keys are the outputs of a seeded bijection, so they are distinct
+// without a hash set, and all operations are generated in parallel before
+// the measured phases.
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "city.h"
+#include "cuckoo_filter.h"
+#include "quotient_filter.h"
+#include "workload.h"
+#include "yeah_filter.h"
+
+size_t cuckoo_cityhash64(uint64_t x)
+{
+	return CityHash64((const char*) &x, sizeof(x));
+}
+
+using Hash = decltype(&cuckoo_cityhash64);
+
+enum OpType : uint8_t {
+	kInsert,
+	kQuery,
+	kDelete,
+	kNegativeQuery,
+};
+
+struct Op {
+	uint64_t key;
+	OpType type;
+};
+
+struct Options {
+	const char *trace = nullptr;
+	KeyTrace::Format format = KeyTrace::kBinary64;
+	uint64_t num_keys = 1 << 20;
+	uint64_t num_ops = 0;
+	double load = 1.0;
+	double mix[3] = {0, 100, 0};
+	double negative = 0;
+	double skew = 0;
+	size_t capacity = 0;
+	unsigned threads = 0;
+	std::string filter = "cuckoo";
+	uint64_t seed = 20211124;
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --trace FILE       replay the keys of FILE instead of synthetic keys\n"
+		"  --format FMT       bin32, bin64 (default) or text\n"
+		"  --keys N           number of synthetic keys (default 2^20)\n"
+		"  --load F           fraction of the keys inserted before the run (default 1)\n"
+		"  --ops N            number of operations in the run (default: number of keys)\n"
+		"  --mix I:Q:D        ratio of inserts, queries and deletes (default 0:100:0)\n"
+		"  --negative F       fraction of queries for absent keys (synthetic keys only)\n"
+		"  --skew S           Zipf exponent of queries (default 0, in order)\n"
+		"  --capacity N       filter capacity (default: number of keys)\n"
+		"  --filter NAME      cuckoo (default), yeah or quotient\n"
+		"  --threads N        threads for workload generation (default: all)\n"
+		"  --seed N           seed of the workload\n",
+		prog);
+	exit(1);
+}
+
+static Options parse_options(int argc, char *argv[])
+{
+	Options opt;
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+		}
+		const char *val = argv[++i];
+		if (strcmp(arg, "--trace") == 0) {
+			opt.trace = val;
+		} else if (strcmp(arg, "--format") == 0) {
+			if (strcmp(val, "bin32") == 0) {
+				opt.format = KeyTrace::kBinary32;
+			} else if (strcmp(val, "bin64") == 0) {
+				opt.format = KeyTrace::kBinary64;
+			} else if (strcmp(val, "text") == 0) {
+				opt.format = KeyTrace::kText;
+			} else {
+				usage(argv[0]);
+			}
+		} else if (strcmp(arg, "--keys") == 0) {
+			opt.num_keys = strtoull(val, nullptr, 0);
+		} else if (strcmp(arg, "--load") == 0) {
+			opt.load = strtod(val, nullptr);
+		} else if (strcmp(arg, "--ops") == 0) {
+			opt.num_ops = strtoull(val, nullptr, 0);
+		} else if (strcmp(arg, "--mix") == 0) {
+			if (sscanf(val, "%lf:%lf:%lf", &opt.mix[0], &opt.mix[1], &opt.mix[2]) != 3) {
+				usage(argv[0]);
+			}
+		} else if (strcmp(arg, "--negative") == 0) {
+			opt.negative = strtod(val, nullptr);
+		} else if (strcmp(arg, "--skew") == 0) {
+			opt.skew = strtod(val, nullptr);
+		} else if (strcmp(arg, "--capacity") == 0) {
+			opt.capacity = strtoull(val, nullptr, 0);
+		} else if (strcmp(arg, "--filter") == 0) {
+			opt.filter = val;
+		} else if (strcmp(arg, "--threads") == 0) {
+			opt.threads = strtoul(val, nullptr, 0);
+		} else if (strcmp(arg, "--seed") == 0) {
+			opt.seed = strtoull(val, nullptr, 0);
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if (opt.trace && opt.negative > 0) {
+		fprintf(stderr, "--negative needs synthetic keys\n");
+		exit(1);
+	}
+	if (opt.load < 0 || opt.load > 1 || opt.mix[0] + opt.mix[1] + opt.mix[2] <= 0) {
+		usage(argv[0]);
+	}
+	return opt;
+}
+
+/**
+ * The keys of the workload: a trace, or the synthetic keys perm(0), perm(1), ...
+ */
+class KeySource
+{
+public:
+	explicit KeySource(const Options &opt)
+		: perm_(opt.seed)
+	{
+		if (opt.trace) {
+			trace_.reset(new KeyTrace(opt.trace, opt.format));
+			size_ = trace_->size();
+		} else {
+			size_ = opt.num_keys;
+		}
+	}
+
+	inline size_t size() const
+	{
+		return size_;
+	}
+
+	inline bool is_trace() const
+	{
+		return trace_ != nullptr;
+	}
+
+	/**
+	 * The i-th key. Synthetic keys continue past size(), which gives the
+	 * run phase fresh keys to insert; i must stay below kAbsentBase.
+	 */
+	inline uint64_t operator[](size_t i) const
+	{
+		return trace_ ? (*trace_)[i] : perm_(i);
+	}
+
+	/**
+	 * A key that is never returned by operator[], for i < 2^63. Only valid
+	 * for synthetic keys.
+	 */
+	inline uint64_t absent(uint64_t i) const
+	{
+		return perm_(kAbsentBase | i);
+	}
+
+	static constexpr uint64_t kAbsentBase = 1ull << 63;
+
+private:
+	std::unique_ptr<KeyTrace> trace_;
+
+	KeyPermutation<uint64_t> perm_;
+
+	size_t size_;
+};
+
+/**
+ * Generate the run phase. Operations are produced in chunks with their own
+ * random streams, so the result does not depend on the number of threads.
+ *
+ * The first pass draws the operation types and the query keys. The keys of
+ * inserts and deletes depend on how many of them precede each operation, so
+ * they are filled in by a second pass once the counts of every chunk are known.
+ */
+static std::vector<Op> generate_ops(const Options &opt, const KeySource &keys, size_t num_loaded)
+{
+	constexpr size_t kChunk = 1 << 14;
+	std::vector<Op> ops(opt.num_ops);
+	size_t num_chunks = (ops.size() + kChunk - 1) / kChunk;
+	double total = opt.mix[0] + opt.mix[1] + opt.mix[2];
+	if (num_loaded == 0 && (opt.mix[1] > 0 || opt.mix[2] > 0)) {
+		fprintf(stderr, "queries and deletes need loaded keys, use a positive --load\n");
+		exit(1);
+	}
+	ZipfDistribution zipf(std::max<size_t>(1, num_loaded), opt.skew);
+
+	// The number of inserts and deletes before each chunk, after the prefix sum.
+	std::vector<size_t> num_inserts(num_chunks + 1);
+	std::vector<size_t> num_deletes(num_chunks + 1);
+
+	parallel_for(num_chunks, [&](size_t begin, size_t end) {
+		std::uniform_real_distribution<double> uniform(0, 1);
+		for (size_t c = begin; c < end; c++) {
+			std::mt19937_64 gen(opt.seed ^ (c * 0x9e3779b97f4a7c15));
+			size_t last = std::min(ops.size(), (c + 1) * kChunk);
+			for (size_t i = c * kChunk; i < last; i++) {
+				double u = uniform(gen) * total;
+				Op &op = ops[i];
+				if (u < opt.mix[0]) {
+					op.type = kInsert;
+					num_inserts[c + 1] += 1;
+					continue;
+				}
+				if (u >= opt.mix[0] + opt.mix[1]) {
+					op.type = kDelete;
+					num_deletes[c + 1] += 1;
+					continue;
+				}
+				op.type = kQuery;
+				if (opt.negative > 0 && uniform(gen) < opt.negative) {
+					op.type = kNegativeQuery;
+					op.key = keys.absent(gen() >> 1);
+					continue;
+				}
+				size_t rank = opt.skew > 0 ? zipf(gen) : i % num_loaded;
+				op.key = keys[rank];
+			}
+		}
+	}, opt.threads, 1);
+
+	for (size_t c = 0; c < num_chunks; c++) {
+		num_inserts[c + 1] += num_inserts[c];
+		num_deletes[c + 1] += num_deletes[c];
+	}
+	size_t total_inserts = num_inserts[num_chunks];
+	size_t total_deletes = num_deletes[num_chunks];
+	if (keys.is_trace() && num_loaded + total_inserts > keys.size()) {
+		fprintf(stderr, "the run inserts %zu keys, but the trace has only %zu unloaded keys\n",
+				total_inserts, keys.size() - num_loaded);
+		exit(1);
+	}
+	if (total_deletes > num_loaded) {
+		fprintf(stderr, "the run deletes %zu keys, but only %zu keys are loaded\n",
+				total_deletes, num_loaded);
+		exit(1);
+	}
+
+	// The first total_deletes ranks of a random permutation of the loaded keys.
+	std::vector<size_t> delete_order;
+	if (total_deletes > 0) {
+		delete_order.resize(num_loaded);
+		for (size_t i = 0; i < num_loaded; i++) {
+			delete_order[i] = i;
+		}
+		std::mt19937_64 gen(opt.seed);
+		for (size_t i = 0; i < total_deletes; i++) {
+			size_t j = i + gen() % (num_loaded - i);
+			std::swap(delete_order[i], delete_order[j]);
+		}
+	}
+
+	parallel_for(num_chunks, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; c++) {
+			size_t next_insert = num_inserts[c];
+			size_t next_delete = num_deletes[c];
+			size_t last = std::min(ops.size(), (c + 1) * kChunk);
+			for (size_t i = c * kChunk; i < last; i++) {
+				Op &op = ops[i];
+				if (op.type == kInsert) {
+					op.key = keys[num_loaded + next_insert++];
+				} else if (op.type == kDelete) {
+					op.key = keys[delete_order[next_delete++]];
+				}
+			}
+		}
+	}, opt.threads, 1);
+	return ops;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<class Filter>
+void run_trace(Filter &filter, const Options &opt, const KeySource &keys)
+{
+	size_t num_loaded = (size_t) (keys.size() * opt.load);
+
+	std::vector<uint64_t> load_keys(num_loaded);
+	parallel_for(num_loaded, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			load_keys[i] = keys[i];
+		}
+	}, opt.threads);
+	std::vector<Op> ops = generate_ops(opt, keys, num_loaded);
+
+	auto start = std::chrono::steady_clock::now();
+	size_t load_count = 0;
+	for (auto x : load_keys) {
+		if (filter.insert(x)) {
+			load_count += 1;
+		}
+	}
+	double load_time = seconds_since(start);
+	log_info("load: %zu/%zu keys inserted, %.2f Mops/s\n",
+			load_count, num_loaded, num_loaded / load_time / 1e6);
+
+	size_t count[4] = {0};
+	size_t positive[4] = {0};
+	start = std::chrono::steady_clock::now();
+	for (auto &op : ops) {
+		count[op.type] += 1;
+		switch (op.type) {
+		case kInsert:
+			positive[kInsert] += filter.insert(op.key);
+			break;
+		case kQuery:
+		case kNegativeQuery:
+			positive[op.type] += filter.query(op.key);
+			break;
+		case kDelete:
+			filter.remove(op.key);
+			break;
+		}
+	}
+	double run_time = seconds_since(start);
+
+	auto ratio = [](size_t a, size_t b) {
+		return b ? (double) a / b : 0.0;
+	};
+	log_info("run: %zu ops, %.2f Mops/s\n", ops.size(), ops.size() / run_time / 1e6);
+	log_info("  insert: %zu, success rate %.5f\n",
+			count[kInsert], ratio(positive[kInsert], count[kInsert]));
+	log_info("  query: %zu, positive rate %.5f\n",
+			count[kQuery], ratio(positive[kQuery], count[kQuery]));
+	log_info("  negative query: %zu, false positive rate %.5f\n",
+			count[kNegativeQuery], ratio(positive[kNegativeQuery], count[kNegativeQuery]));
+	log_info("  delete: %zu\n", count[kDelete]);
+}
+
+int main(int argc, char *argv[])
+{
+	Options opt = parse_options(argc, argv);
+	KeySource keys(opt);
+	if (keys.size() == 0) {
+		fprintf(stderr, "no keys\n");
+		return 1;
+	}
+	if (opt.num_ops == 0) {
+		opt.num_ops = keys.size();
+	}
+	size_t capacity = opt.capacity ? opt.capacity : keys.size();
+	log_info("filter: %s, keys: %zu, capacity: %zu\n",
+			opt.filter.c_str(), keys.size(), capacity);
+
+	if (opt.filter == "cuckoo") {
+		CuckooFilter<12, uint64_t, Hash, 4> filter(cuckoo_cityhash64, capacity);
+		run_trace(filter, opt, keys);
+	} else if (opt.filter == "yeah") {
+		YeahFilter<12, uint64_t, Hash, 4> filter(cuckoo_cityhash64, capacity);
+		run_trace(filter, opt, keys);
+	} else if (opt.filter == "quotient") {
+		QuotientFilter<12, uint64_t, Hash> filter(cuckoo_cityhash64, capacity);
+		run_trace(filter, opt, keys);
+	} else {
+		usage(argv[0]);
+	}
+	return 0;
+}